@@ -1,7 +1,70 @@
 #include "esp01.h"
 
-#define ESP01_DRIVER_DEBUG
+#if ESP01_TRACE_LEVEL >= ESP01_TRACE_LEVEL_EVENTS
+#define ESP01_TRACE_EVENT(inst, event) esp01_trace_record(inst, ESP01_TRACE_EVENT, &(uint8_t) {event}, 1)
+#else
+#define ESP01_TRACE_EVENT(inst, event) ((void) 0)
+#endif
+
+#if ESP01_TRACE_LEVEL >= ESP01_TRACE_LEVEL_TX
+#define ESP01_TRACE_TX(inst, data, len) esp01_trace_record(inst, ESP01_TRACE_TX, data, len)
+#else
+#define ESP01_TRACE_TX(inst, data, len) ((void) 0)
+#endif
+
+#if ESP01_TRACE_LEVEL >= ESP01_TRACE_LEVEL_RX
+#define ESP01_TRACE_RX(inst, data, len) esp01_trace_record(inst, ESP01_TRACE_RX, data, len)
+#else
+#define ESP01_TRACE_RX(inst, data, len) ((void) 0)
+#endif
+
+#if ESP01_TRACE_LEVEL > 0
+// Write bytes at the head of the trace ring
+static void esp01_trace_put(esp01_trace_t *trace, const void *data, uint len) {
+    const uint8_t *bytes = data;
+    for (uint i = 0; i < len; i++) {
+        trace->ring[trace->head] = bytes[i];
+        trace->head = (trace->head + 1) % ESP01_TRACE_RING_LENGTH;
+    }
+    trace->used += len;
+}
+
+// Remove the oldest record of the trace ring
+static void esp01_trace_drop(esp01_trace_t *trace) {
+    uint len = trace->ring[(trace->tail + ESP01_TRACE_HEADER_LENGTH - 1) % ESP01_TRACE_RING_LENGTH];
+    trace->tail = (trace->tail + ESP01_TRACE_HEADER_LENGTH + len) % ESP01_TRACE_RING_LENGTH;
+    trace->used -= ESP01_TRACE_HEADER_LENGTH + len;
+}
+
+// Store a record in the trace ring (overwriting the oldest records)
+static void esp01_trace_store(esp01_trace_t *trace, esp01_trace_type_t type, const void *data, size_t len) {
+    if (len > ESP01_TRACE_RING_LENGTH - ESP01_TRACE_HEADER_LENGTH) {
+        len = ESP01_TRACE_RING_LENGTH - ESP01_TRACE_HEADER_LENGTH;
+    }
+
+    while (ESP01_TRACE_RING_LENGTH - trace->used < ESP01_TRACE_HEADER_LENGTH + len) {
+        esp01_trace_drop(trace);
+        trace->dropped++;
+    }
+
+    uint32_t timestamp = time_us_32();
+    uint8_t header[ESP01_TRACE_HEADER_LENGTH] = {timestamp, timestamp >> 8, timestamp >> 16, timestamp >> 24, type,
+                                                 len};
+    esp01_trace_put(trace, header, ESP01_TRACE_HEADER_LENGTH);
+    esp01_trace_put(trace, data, len);
+}
 
+// Store data in the trace ring, in records of at most ESP01_TRACE_PAYLOAD_LENGTH bytes
+static void esp01_trace_record(esp01_inst_t *inst, esp01_trace_type_t type, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    do {
+        size_t record_len = len < ESP01_TRACE_PAYLOAD_LENGTH ? len : ESP01_TRACE_PAYLOAD_LENGTH;
+        esp01_trace_store(&inst->trace, type, bytes, record_len);
+        bytes += record_len;
+        len -= record_len;
+    } while (len > 0);
+}
+#endif
 
 esp01_inst_t *esp01_init(uart_inst_t *uart_inst, uint baud_rate, uint tx_pin, uint rx_pin) {
     esp01_inst_t *inst = malloc(sizeof(esp01_inst_t));
@@ -17,6 +80,38 @@ esp01_inst_t *esp01_init(uart_inst_t *uart_inst, uint baud_rate, uint tx_pin, ui
     inst->uart_settings.baud_rate = baud_rate;
     esp01_reinit(inst);
 
+    inst->urc_handler = NULL;
+    inst->urc_ctx = NULL;
+
+    memset(&inst->sched, 0, sizeof(esp01_sched_t));
+    lock_init(&inst->sched.core, next_striped_spin_lock_num());
+    inst->sched.owner = LOCK_INVALID_OWNER_ID;
+    inst->sched.timeout_ms = ESP01_SCHED_DEFAULT_TIMEOUT;
+
+    memset(&inst->latency, 0, sizeof(esp01_latency_t));
+    esp01_set_adaptive_timeouts(inst, true, ESP01_ADAPTIVE_MIN_TIMEOUT, ESP01_ADAPTIVE_MAX_TIMEOUT);
+    memset(&inst->recovery, 0, sizeof(esp01_recovery_t));
+    esp01_set_recovery(inst, ESP01_RECOVERY_RETRIES, ESP01_RECOVERY_BACKOFF);
+    inst->last_status = ESP01_RSP_OK;
+    inst->client_links = 0;
+
+    memset(&inst->flow, 0, sizeof(esp01_flow_t));
+    inst->flow.supported = true;
+    inst->flow.stats.last_free = inst->flow.stats.last_min = inst->flow.stats.lowest_free = ESP01_UNDEFINED;
+    esp01_set_flow_control(inst, true, false, ESP01_FLOW_LOW_WATERMARK, ESP01_FLOW_HIGH_WATERMARK,
+                           ESP01_FLOW_SAMPLE_INTERVAL);
+
+#if ESP01_TRACE_LEVEL > 0
+    inst->trace.head = inst->trace.tail = inst->trace.used = inst->trace.dropped = 0;
+#endif
+
+    memset(&inst->dns_cache, 0, sizeof(esp01_dns_cache_t));
+    inst->dns_cache.ttl_ms = ESP01_DNS_DEFAULT_TTL;
+    inst->dns_cache.negative_ttl_ms = ESP01_DNS_DEFAULT_NEGATIVE_TTL;
+
+    esp01_socket_options_t options = ESP01_DEFAULT_SOCKET_OPTIONS;
+    inst->socket_options = options;
+
     return inst;
 }
 
@@ -26,6 +121,7 @@ void esp01_deinit(esp01_inst_t *inst) {
     gpio_deinit(inst->tx_pin);
     gpio_deinit(inst->rx_pin);
 
+    free(inst->flow.pending);
     free(inst);
 }
 
@@ -46,15 +142,211 @@ void esp01_set_host_uart(esp01_inst_t *inst, esp01_uart_settings_t uart_set) {
     uart_set_format(inst->uart_inst, uart_set.data_bits, uart_set.stop_bits, uart_set.parity);
 }
 
-char *esp01_at_cmd(esp01_inst_t *inst, uint timeout_ms, char cmd_mode, char *label, ...) {
-    // Allocate memory for the command
-    char *o_cmd = malloc(ESP01_CMD_LENGTH + 1);
+// Get the best waiting caller (highest priority, then first arrived)
+static esp01_sched_ticket_t *esp01_sched_next(esp01_sched_t *sched) {
+    esp01_sched_ticket_t *next = NULL;
+
+    for (int i = 0; i < ESP01_SCHED_QUEUE_LENGTH; i++) {
+        esp01_sched_ticket_t *ticket = &sched->queue[i];
+        if (!ticket->used) {
+            continue;
+        }
+        if (next == NULL || ticket->priority > next->priority ||
+            (ticket->priority == next->priority && (int32_t) (ticket->seq - next->seq) < 0)) {
+            next = ticket;
+        }
+    }
+
+    return next;
+}
+
+bool esp01_lock(esp01_inst_t *inst, esp01_priority_t priority, uint timeout_ms) {
+    // The priority indexes the statistics
+    if ((uint) priority >= ESP01_PRIORITIES) {
+        return false;
+    }
+
+    esp01_sched_t *sched = &inst->sched;
+    lock_owner_id_t caller = lock_get_caller_owner_id();
+    bool irq = __get_current_exception() != 0;
+
+    // Interrupt handlers can't wait
+    if (irq) {
+        timeout_ms = 0;
+    }
+
+    uint64_t start = time_us_64();
+    absolute_time_t until = make_timeout_time_ms(timeout_ms);
+
+    uint32_t save = spin_lock_blocking(sched->core.spin_lock);
+
+    // Nested lock
+    if (sched->owner == caller && sched->owner_irq == irq) {
+        sched->depth++;
+        spin_unlock(sched->core.spin_lock, save);
+        return true;
+    }
+
+    esp01_sched_ticket_t *ticket = NULL;
+    for (int i = 0; i < ESP01_SCHED_QUEUE_LENGTH; i++) {
+        if (!sched->queue[i].used) {
+            ticket = &sched->queue[i];
+            break;
+        }
+    }
+
+    if (ticket == NULL) {
+        sched->stats.rejected++;
+        spin_unlock(sched->core.spin_lock, save);
+        return false;
+    }
+
+    ticket->used = true;
+    ticket->priority = priority;
+    ticket->seq = sched->next_seq++;
+
+    while (true) {
+        if (sched->owner == LOCK_INVALID_OWNER_ID && esp01_sched_next(sched) == ticket) {
+            ticket->used = false;
+            sched->owner = caller;
+            sched->owner_irq = irq;
+            sched->depth = 1;
+
+            uint32_t wait_us = time_us_64() - start;
+            sched->stats.acquired[priority]++;
+            sched->stats.total_wait_us[priority] += wait_us;
+            if (wait_us > sched->stats.max_wait_us[priority]) {
+                sched->stats.max_wait_us[priority] = wait_us;
+            }
+
+            spin_unlock(sched->core.spin_lock, save);
+            return true;
+        }
+
+        if (timeout_ms == 0 || time_reached(until)) {
+            ticket->used = false;
+
+            // A try that finds the instance busy didn't wait
+            if (timeout_ms > 0) {
+                sched->stats.timeouts++;
+            }
+
+            // The next caller may be this one's successor
+            lock_internal_spin_unlock_with_notify(&sched->core, save);
+            return false;
+        }
+
+        lock_internal_spin_unlock_with_best_effort_wait_or_timeout(&sched->core, save, until);
+        save = spin_lock_blocking(sched->core.spin_lock);
+    }
+}
+
+void esp01_unlock(esp01_inst_t *inst) {
+    esp01_sched_t *sched = &inst->sched;
+
+    lock_owner_id_t caller = lock_get_caller_owner_id();
+    bool irq = __get_current_exception() != 0;
+
+    uint32_t save = spin_lock_blocking(sched->core.spin_lock);
+
+    // Unlocking an instance owned by someone else (or not locked) would hand it to a second owner
+    bool owned = sched->depth > 0 && sched->owner == caller && sched->owner_irq == irq;
+    assert(owned);
+    if (!owned) {
+        spin_unlock(sched->core.spin_lock, save);
+        return;
+    }
+
+    if (--sched->depth == 0) {
+        sched->owner = LOCK_INVALID_OWNER_ID;
+    }
+
+    lock_internal_spin_unlock_with_notify(&sched->core, save);
+}
+
+void esp01_set_sched_timeout(esp01_inst_t *inst, uint timeout_ms) {
+    inst->sched.timeout_ms = timeout_ms;
+}
+
+esp01_sched_stats_t esp01_get_sched_stats(esp01_inst_t *inst) {
+    uint32_t save = spin_lock_blocking(inst->sched.core.spin_lock);
+    esp01_sched_stats_t stats = inst->sched.stats;
+    spin_unlock(inst->sched.core.spin_lock, save);
+
+    return stats;
+}
+
+// Command properties
+struct esp01_cmd_properties {
+    const char *label;
+    esp01_priority_t priority;
+    bool idempotent;        // Can be sent again after a failure
+    bool adaptive;          // The latency only depends on the device (not on the network nor on the params)
+} typedef esp01_cmd_properties_t;
+
+// Commands with non default properties. Queries are low priority, idempotent and adaptive. Other commands are normal
+// priority and adaptive, and are never sent twice unless they are listed as idempotent here.
+static const esp01_cmd_properties_t esp01_cmd_properties[] = {
+        {AT_IP_SEND,                   ESP01_PRIORITY_HIGH,   false, false},
+        {AT_IP_SEND_EX,                ESP01_PRIORITY_HIGH,   false, false},
+        {AT_IP_CLOSE,                  ESP01_PRIORITY_HIGH,   false, false},
+        {AT_TEST,                      ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_VERSION,                   ESP01_PRIORITY_LOW,    true,  true},
+        {AT_RAM,                       ESP01_PRIORITY_LOW,    true,  true},
+        {AT_WIFI_STATE,                ESP01_PRIORITY_LOW,    true,  true},
+        {AT_WIFI_AP_LIST_STATIONS,     ESP01_PRIORITY_LOW,    true,  true},
+        {AT_IP_STATUS,                 ESP01_PRIORITY_LOW,    true,  true},
+        {AT_IP_LOCAL_ADDRESS,          ESP01_PRIORITY_LOW,    true,  true},
+        {AT_IP_PING,                   ESP01_PRIORITY_LOW,    true,  false},
+        {AT_IP_DOMAIN,                 ESP01_PRIORITY_NORMAL, true,  false},
+        {AT_WIFI_LIST_NETWORKS,        ESP01_PRIORITY_NORMAL, true,  false},
+        {AT_SLEEP_CFG,                 ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_STORE_MODE,                ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_WIFI_MODE,                 ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_WIFI_AP_CFG,               ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_IP_MUX_MODE,               ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_IP_SERVER_MAX_CONNECTIONS, ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_IP_SERVER_TIMEOUT,         ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_IP_DNS,                    ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_IP_SOCKET_CFG,             ESP01_PRIORITY_NORMAL, true,  true},
+        {AT_RESET,                     ESP01_PRIORITY_NORMAL, false, false},
+        {AT_DEEP_SLEEP,                ESP01_PRIORITY_NORMAL, false, false},
+        {AT_FACTORY_RESET,             ESP01_PRIORITY_NORMAL, false, false},
+        {AT_WIFI_STATION_CONNECT,      ESP01_PRIORITY_NORMAL, false, false},
+        {AT_WIFI_STATION_DISCONNECT,   ESP01_PRIORITY_NORMAL, false, false},
+        {AT_IP_START,                  ESP01_PRIORITY_NORMAL, false, false},
+};
+
+// Get the properties of a built command
+static esp01_cmd_properties_t esp01_cmd_properties_get(const char *cmd) {
+    // Queries are housekeeping
+    const char *mode = cmd + strcspn(cmd, "=?\n");
+    if (*mode == AT_QUERY) {
+        return (esp01_cmd_properties_t) {NULL, ESP01_PRIORITY_LOW, true, true};
+    }
+
+    for (size_t i = 0; i < sizeof(esp01_cmd_properties) / sizeof(esp01_cmd_properties[0]); i++) {
+        size_t len = strlen(esp01_cmd_properties[i].label);
+        if (strncmp(cmd, esp01_cmd_properties[i].label, len) == 0 && cmd + len == mode) {
+            return esp01_cmd_properties[i];
+        }
+    }
+
+    return (esp01_cmd_properties_t) {NULL, ESP01_PRIORITY_NORMAL, false, true};
+}
+
+// Build the command string from the label, the mode and the varargs params
+static size_t esp01_build_cmd(char *o_cmd, char cmd_mode, const char *label, va_list args) {
     char *cmd = o_cmd;
     *cmd = '\0';
 
     // Concatenate the label of the command
+    size_t label_len = strnlen(label, ESP01_CMD_LENGTH);
+    if (label_len >= ESP01_CMD_LENGTH) {
+        return 0;
+    }
     strcpy(cmd, label);
-    cmd += strlen(label);
+    cmd += label_len;
 
     // Concatenate the command mode
     if (cmd_mode != '\0') {
@@ -63,206 +355,846 @@ char *esp01_at_cmd(esp01_inst_t *inst, uint timeout_ms, char cmd_mode, char *lab
         *cmd = '\0';
     }
 
-    va_list args;
-    va_start(args, label);
-
     bool flag = true;
     while (flag) {
-        // Return if the command overflows
-        if (cmd - o_cmd >= ESP01_CMD_LENGTH) {
-            return NULL;
-        }
-
         // Get param from varargs and concatenate until it reaches \r or \n
-        char *param = va_arg(args, char*);
-        char c;
-        for (int i = 0; i < strnlen(param, ESP01_CMD_LENGTH); i++) {
-            c = param[i];
-            if (c == '\r' || c == '\n') {
+        const char *param = va_arg(args, const char*);
+        for (const char *c = param; *c != '\0'; c++) {
+            // Return if the command overflows
+            if (cmd - o_cmd >= ESP01_CMD_LENGTH) {
+                return 0;
+            }
+
+            if (*c == '\r' || *c == '\n') {
                 *cmd = '\n';
                 cmd++;
                 *cmd = '\0';
                 flag = false;
                 break;
             } else {
-                *cmd = c;
+                *cmd = *c;
                 cmd++;
                 *cmd = '\0';
             }
         }
     }
 
-    va_end(args);
+    return cmd - o_cmd;
+}
 
-#ifdef ESP01_DRIVER_DEBUG
-    printf(">%s", o_cmd);
-#endif
+// Command exchange
+struct esp01_exchange {
+    const char *cmd;            // Command (NULL to only receive unsolicited data)
+    size_t cmd_len;
+    const char *payload;        // Data sent after the '>' prompt (NULL if none)
+    size_t payload_len;
+    uint timeout_ms;
+    esp01_rsp_sink_t sink;
+    void *ctx;
+    uint32_t max_gap_us;        // Longest silence of the device (set by the exchange)
+    bool require_echo;          // Ignore termination words received before the command echo
+    bool stop_at_prompt;        // End at the '>' prompt (the caller writes the data itself)
+    bool payload_sent;          // The data was written by the caller, wait for SEND OK/SEND FAIL
+} typedef esp01_exchange_t;
+
+// Sink discarding the response
+static bool esp01_discard_sink(const char *chunk, size_t len, void *ctx) {
+    return true;
+}
+
+// Check for an unsolicited connection event (<link ID>,CONNECT / <link ID>,CLOSED) and dispatch it
+static bool esp01_urc_line(esp01_inst_t *inst, const char *line) {
+    int link_id;
+    char event[16];
+
+    if (sscanf(line, "%d,%15[^\n]", &link_id, event) != 2) {
+        return false;
+    }
+
+    esp01_urc_t urc;
+    if (strcmp(event, "CONNECT") == 0) {
+        urc = ESP01_URC_CONNECT;
+    } else if (strcmp(event, "CLOSED") == 0 || strcmp(event, "CONNECT FAIL") == 0) {
+        urc = ESP01_URC_CLOSED;
+    } else {
+        return false;
+    }
+
+    if (inst->urc_handler != NULL) {
+        inst->urc_handler(inst, urc, link_id, NULL, 0, inst->urc_ctx);
+    }
 
-    // Send the command if possible
-    if (uart_is_writable(inst->uart_inst)) {
-        // Allocate memory for the device response
-        char *o_rsp = malloc(ESP01_RSP_LENGTH + 1);
-        char *rsp = o_rsp;
-        *rsp = '\0';
+    // The link may be reused by a server client
+    if (urc == ESP01_URC_CLOSED && link_id >= 0 && link_id < ESP01_MAX_LINKS) {
+        inst->client_links &= ~(1u << link_id);
+    }
+    return true;
+}
+
+// Send a command and hand the response lines to the sink until a termination word (OK/ERROR)
+static esp01_rsp_status_t esp01_transfer(esp01_inst_t *inst, esp01_exchange_t *ex) {
+    if (ex->cmd != NULL) {
+        ESP01_TRACE_TX(inst, ex->cmd, ex->cmd_len);
+
+        // Send the command if possible
+        if (!uart_is_writable(inst->uart_inst)) {
+            ESP01_TRACE_EVENT(inst, ESP01_TRACE_UNWRITABLE);
+            return ESP01_RSP_UNWRITABLE;
+        }
 
-        // Send command
-        for (char *c = o_cmd; c < cmd; c++) {
+        for (const char *c = ex->cmd; c < ex->cmd + ex->cmd_len; c++) {
             if (*c == '\n') {
                 uart_putc(inst->uart_inst, '\r');
             }
             uart_putc(inst->uart_inst, *c);
         }
+    }
+
+    // Current line (a longer line is handed to the sink in several chunks)
+    char line[ESP01_RSP_CHUNK_LENGTH + 1];
+    size_t len = 0;
+    bool partial = false;
+    bool deliver = true;
+    bool prompted = ex->payload_sent;
+    bool sending = ex->payload != NULL || ex->stop_at_prompt || ex->payload_sent;
+    bool echoed = false;
+    bool framing = false;
+
+    // Socket data (+IPD, or +CIPRECVDATA for the response data) being received
+    int ipd_link = ESP01_UNDEFINED;
+    size_t ipd_remaining = 0;
+    bool ipd_response = false;
+
+    uint64_t last_us = time_us_64();
+    ex->max_gap_us = 0;
+
+    while (uart_is_readable_within_us(inst->uart_inst, ex->timeout_ms * 1000)) {
+        // Read the data register to get the receive errors along with the character
+        uint32_t dr = uart_get_hw(inst->uart_inst)->dr;
+        char c = dr & UART_UARTDR_DATA_BITS;
+        if (dr & (UART_UARTDR_OE_BITS | UART_UARTDR_BE_BITS | UART_UARTDR_PE_BITS | UART_UARTDR_FE_BITS)) {
+            framing = true;
+        }
+
+        uint64_t now_us = time_us_64();
+        if (now_us - last_us > ex->max_gap_us) {
+            ex->max_gap_us = now_us - last_us;
+        }
+        last_us = now_us;
+
+        // Socket data is binary and is handed to the URC handler (or to the sink) as is
+        if (ipd_remaining > 0) {
+            line[len++] = c;
+            ipd_remaining--;
+            if (len == ESP01_RSP_CHUNK_LENGTH || ipd_remaining == 0) {
+                ESP01_TRACE_RX(inst, line, len);
+                if (ipd_response) {
+                    if (deliver && !ex->sink(line, len, ex->ctx)) {
+                        deliver = false;
+                    }
+                } else if (inst->urc_handler != NULL) {
+                    inst->urc_handler(inst, ESP01_URC_DATA, ipd_link, line, len, inst->urc_ctx);
+                }
+                len = 0;
+            }
+            continue;
+        }
+
+        if (c == '\0' || c == '\r') {
+            continue;
+        }
+
+        // Hand over to the caller when the device is ready to receive the data
+        if (ex->stop_at_prompt && len == 0 && c == '>') {
+            ESP01_TRACE_EVENT(inst, ESP01_TRACE_PROMPT);
+            return ESP01_RSP_OK;
+        }
+
+        // Send the payload when the device is ready to receive it
+        if (ex->payload != NULL && !prompted && len == 0 && c == '>') {
+            ESP01_TRACE_EVENT(inst, ESP01_TRACE_PROMPT);
+            ESP01_TRACE_TX(inst, ex->payload, ex->payload_len);
+            for (const char *p = ex->payload; p < ex->payload + ex->payload_len; p++) {
+                uart_putc_raw(inst->uart_inst, *p);
+            }
+            prompted = true;
+
+            // The device can't answer while the payload is being written
+            last_us = time_us_64();
+            continue;
+        }
+
+        line[len++] = c;
+        line[len] = '\0';
+
+        // Check for the socket data header (+IPD,<link ID>,<len>[,<remote IP>,<remote port>]:)
+        if (c == ':' && !partial && strncmp(line, "+IPD,", 5) == 0) {
+            ESP01_TRACE_RX(inst, line, len);
+            int a, b;
+            int n = sscanf(line, "+IPD,%d,%d", &a, &b);
+            if (n == 2) {
+                ipd_link = a;
+                ipd_remaining = b;
+            } else if (n == 1) {
+                ipd_link = ESP01_UNDEFINED;
+                ipd_remaining = a;
+            }
+            ipd_response = false;
+            len = 0;
+            continue;
+        }
 
-        // Concatenate the response until it reaches a termination word (OK/ERROR)
-        while (uart_is_readable_within_us(inst->uart_inst, timeout_ms * 1000)) {
-            *rsp = uart_getc(inst->uart_inst);
-            if (*rsp == '\0' || *rsp == '\r') {
+        // Check for the passive mode data header (+CIPRECVDATA,<len>:), the data is the rest of the response line
+        if (c == ':' && !partial && strncmp(line, "+CIPRECVDATA,", 13) == 0) {
+            ESP01_TRACE_RX(inst, line, len);
+            int a;
+            if (sscanf(line, "+CIPRECVDATA,%d", &a) == 1 && a > 0) {
+                ipd_remaining = a;
+                ipd_response = true;
+            }
+            if (deliver && !ex->sink(line, len, ex->ctx)) {
+                deliver = false;
+            }
+            partial = true;
+            len = 0;
+            continue;
+        }
+
+        if (c != '\n') {
+            // Flush the chunk if the line doesn't fit
+            if (len == ESP01_RSP_CHUNK_LENGTH) {
+                ESP01_TRACE_RX(inst, line, len);
+                if (deliver && !ex->sink(line, len, ex->ctx)) {
+                    deliver = false;
+                }
+                partial = true;
+                len = 0;
+            }
+            continue;
+        }
+
+        ESP01_TRACE_RX(inst, line, len);
+
+        if (!partial) {
+            // Check for the command echo (everything before belongs to a previous exchange)
+            if (ex->cmd != NULL && len >= ex->cmd_len && memcmp(line + len - ex->cmd_len, ex->cmd, ex->cmd_len) == 0) {
+                deliver = ex->sink(NULL, 0, ex->ctx);
+                echoed = true;
+                framing = false;
+                len = 0;
                 continue;
             }
-#ifdef ESP01_DRIVER_DEBUG
-            putchar(*rsp);
-#endif
-            rsp++;
 
-            // Return if the response overflows
-            if (rsp - o_rsp >= ESP01_RSP_LENGTH) {
-#ifdef ESP01_DRIVER_DEBUG
-                printf("Response overflow!\n");
-#endif
-                return NULL;
+            // Check for unsolicited events
+            if (esp01_urc_line(inst, line)) {
+                len = 0;
+                continue;
             }
 
-            *rsp = '\0';
+            // Check for termination word (OK only precedes the prompt when sending data, TIMEOUT if none)
+            esp01_rsp_status_t status = ESP01_RSP_TIMEOUT;
+            if (strcmp(line, "OK\n") == 0 && !sending) {
+                status = ESP01_RSP_OK;
+            } else if (strcmp(line, "SEND OK\n") == 0 && prompted) {
+                status = ESP01_RSP_OK;
+            } else if (strcmp(line, "ERROR\n") == 0 || (strcmp(line, "SEND FAIL\n") == 0 && prompted)) {
+                status = ESP01_RSP_ERROR;
+            } else if (strncmp(line, "busy ", 5) == 0) {
+                // The device is still processing a previous command and ignored this one
+                status = ESP01_RSP_BUSY;
+            }
 
-            // Check for termination word
-            if (*(rsp - 1) == '\n') {
-                if (strstr(o_rsp, o_cmd) != NULL) {
-                    rsp = o_rsp;
-                    *rsp = '\0';
-                } else if ((strstr(o_rsp, "\nOK\n") != NULL) || (strstr(o_rsp, "\nERROR\n") != NULL)) {
-                    // Reallocate to free memory
-                    return realloc(o_rsp, rsp - o_rsp + 1);
+            if (status != ESP01_RSP_TIMEOUT && (echoed || !ex->require_echo)) {
+                // The response can't be trusted if a character was lost or corrupted
+                if (framing && status != ESP01_RSP_BUSY) {
+                    ESP01_TRACE_EVENT(inst, ESP01_TRACE_FRAMING);
+                    return ESP01_RSP_FRAMING;
+                }
+                if (status == ESP01_RSP_BUSY) {
+                    ESP01_TRACE_EVENT(inst, ESP01_TRACE_BUSY);
                 }
+                return status;
             }
         }
-#ifdef ESP01_DRIVER_DEBUG
-        printf("Timeout!\n");
-#endif
-        return NULL;
-    } else {
-#ifdef ESP01_DRIVER_DEBUG
-        printf("UART not writeable!\n");
-#endif
-        return NULL;
+
+        if (deliver && !ex->sink(line, len, ex->ctx)) {
+            deliver = false;
+        }
+        partial = false;
+        len = 0;
+    }
+    if (ex->cmd != NULL) {
+        ESP01_TRACE_EVENT(inst, ESP01_TRACE_TIMEOUT);
     }
+    return ESP01_RSP_TIMEOUT;
 }
 
-bool esp01_rsp_ok(char *rsp) {
-    // Return if it's the null pointer
-    if (rsp == NULL) {
-        return false;
-    }
+void esp01_set_adaptive_timeouts(esp01_inst_t *inst, bool enabled, uint min_ms, uint max_ms) {
+    inst->latency.adaptive = enabled;
+    inst->latency.min_ms = min_ms;
+    inst->latency.max_ms = max_ms;
+}
 
-    // Check for OK
-    if (strstr(rsp, "\nOK\n") != NULL) {
-        return true;
+// Get the class key of a command (hash of the label and the mode)
+static uint32_t esp01_latency_key(const char *cmd) {
+    uint32_t key = 2166136261u;
+    for (const char *c = cmd; *c != '\0'; c++) {
+        key = (key ^ (uint8_t) *c) * 16777619u;
+        if (*c == AT_SET || *c == AT_QUERY || *c == '\n') {
+            break;
+        }
     }
+    return key;
+}
 
-    // Fallback: return false (ERROR/malformed response)
-    return false;
+// Find the class of a command (NULL if it has no samples)
+static esp01_latency_class_t *esp01_latency_find(esp01_inst_t *inst, uint32_t key) {
+    for (int i = 0; i < ESP01_LATENCY_CLASSES; i++) {
+        esp01_latency_class_t *cls = &inst->latency.classes[i];
+        if (cls->samples > 0 && cls->key == key) {
+            return cls;
+        }
+    }
+    return NULL;
 }
 
-bool esp01_rsp_ok_free(char *rsp) {
-    // Return if it's the null pointer
-    if (rsp == NULL) {
-        free(rsp);
-        return false;
+// Get the timeout of a class
+static uint esp01_latency_timeout(esp01_latency_t *latency, esp01_latency_class_t *cls, uint timeout_ms) {
+    if (cls == NULL) {
+        return timeout_ms;
     }
 
-    // Check for OK
-    if (strstr(rsp, "\nOK\n") != NULL) {
-        free(rsp);
-        return true;
+    if (cls->samples >= ESP01_ADAPTIVE_MIN_SAMPLES) {
+        timeout_ms = (cls->srtt_us + 4 * cls->rttvar_us + 999) / 1000;
+        if (timeout_ms < latency->min_ms) {
+            timeout_ms = latency->min_ms;
+        }
     }
 
-    // Fallback: return false (ERROR/malformed response)
-    free(rsp);
-    return false;
+    for (uint i = 0; i < cls->backoff && timeout_ms < latency->max_ms; i++) {
+        timeout_ms *= 2;
+    }
+
+    if (timeout_ms > latency->max_ms) {
+        timeout_ms = latency->max_ms;
+    }
+    return timeout_ms;
 }
 
-// Basic
+// Update the estimate of a class after an exchange
+static void esp01_latency_update(esp01_latency_t *latency, uint32_t key, esp01_rsp_status_t status,
+                                 uint32_t gap_us) {
+    esp01_latency_class_t *cls = NULL;
+    for (int i = 0; i < ESP01_LATENCY_CLASSES; i++) {
+        esp01_latency_class_t *c = &latency->classes[i];
+        if (c->samples > 0 && c->key == key) {
+            cls = c;
+            break;
+        }
+        // Replace the least recently used class
+        if (cls == NULL || c->samples == 0 ||
+            (cls->samples > 0 && (int32_t) (c->last_used - cls->last_used) < 0)) {
+            cls = c;
+        }
+    }
 
-bool esp01_test(esp01_inst_t *inst) {
-    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_TEST, "\n");
-    return esp01_rsp_ok_free(rsp);
-}
+    if (cls->samples == 0 || cls->key != key) {
+        memset(cls, 0, sizeof(esp01_latency_class_t));
+        cls->key = key;
+    }
+    cls->last_used = latency->clock++;
 
-bool esp01_reset(esp01_inst_t *inst) {
-    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_RESET, "\n");
-    return esp01_rsp_ok_free(rsp);
+    // A timeout gives no sample, back off until the next response
+    if (status == ESP01_RSP_TIMEOUT) {
+        if (cls->samples > 0) {
+            cls->backoff++;
+        }
+        return;
+    }
+
+    cls->backoff = 0;
+    if (cls->samples == 0) {
+        cls->srtt_us = gap_us;
+        cls->rttvar_us = gap_us / 2;
+    } else {
+        uint32_t err = gap_us > cls->srtt_us ? gap_us - cls->srtt_us : cls->srtt_us - gap_us;
+        cls->rttvar_us = cls->rttvar_us - cls->rttvar_us / 4 + err / 4;
+        cls->srtt_us = cls->srtt_us - cls->srtt_us / 8 + gap_us / 8;
+    }
+    cls->samples++;
 }
 
-bool esp01_get_version(esp01_inst_t *inst, esp01_version_t *ver) {
-    char *o_rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_VERSION, "\n");
-    char *rsp = o_rsp;
+bool esp01_get_latency_estimate(esp01_inst_t *inst, char cmd_mode, const char *label,
+                                esp01_latency_estimate_t *estimate) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    if (strlen(label) + 2 > ESP01_CMD_LENGTH) {
+        return false;
+    }
+    sprintf(cmd, "%s%c", label, cmd_mode == AT_EXECUTE ? '\n' : cmd_mode);
 
-    if (esp01_rsp_ok(rsp)) {
-        ver->at = malloc(ESP01_CMD_LENGTH + 1);
-        ver->sdk = malloc(ESP01_CMD_LENGTH + 1);
-        ver->bin = malloc(ESP01_CMD_LENGTH + 1);
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
 
-        *(ver->at) = *(ver->sdk) = *(ver->bin) = '\0';
+    esp01_latency_class_t *cls = esp01_latency_find(inst, esp01_latency_key(cmd));
+    if (cls != NULL) {
+        estimate->samples = cls->samples;
+        estimate->srtt_us = cls->srtt_us;
+        estimate->rttvar_us = cls->rttvar_us;
+        estimate->timeout_ms = esp01_latency_timeout(&inst->latency, cls, inst->latency.max_ms);
+    }
 
-        sscanf(rsp, "AT version:%[^\n]", ver->at);
-        rsp = strstr(rsp, "\n") + 1;
+    esp01_unlock(inst);
+    return cls != NULL;
+}
 
-        sscanf(rsp, "SDK version:%[^\n]", ver->sdk);
-        rsp = strstr(rsp, "\n") + 1;
+void esp01_set_recovery(esp01_inst_t *inst, uint max_retries, uint backoff_ms) {
+    inst->recovery.max_retries = max_retries;
+    inst->recovery.backoff_ms = backoff_ms;
+}
 
-        if (strstr(rsp, "\n") != NULL) {
-            rsp = strstr(rsp, "\n") + 1;
+// Resynchronize the link (the caller holds the lock)
+static bool esp01_resync_locked(esp01_inst_t *inst) {
+    ESP01_TRACE_EVENT(inst, ESP01_TRACE_RESYNC);
+    inst->recovery.stats.resyncs++;
+
+    // Drain the data until the device is quiet (unsolicited events are still handed to the URC handler)
+    esp01_exchange_t drain = {NULL, 0, NULL, 0, ESP01_RESYNC_QUIET_TIME, esp01_discard_sink, NULL, 0, false, false,
+                              false};
+    uint64_t start_us = time_us_64();
+    while (esp01_transfer(inst, &drain) != ESP01_RSP_TIMEOUT) {
+        if (time_us_64() - start_us > ESP01_EXTENDED_TIMEOUT * 1000) {
+            inst->recovery.stats.resync_failures++;
+            return false;
         }
+    }
 
-        sscanf(rsp, "Bin version:%[^\n]", ver->bin);
-
-        free(o_rsp);
-        return true;
-    } else {
-        free(o_rsp);
+    // Send a probe that can't be mistaken with a previous command, the device doesn't know it and answers ERROR
+    char cmd[ESP01_CMD_LENGTH + 1];
+    size_t cmd_len = sprintf(cmd, "AT+SYNC%08lX\n", (unsigned long) (time_us_32() ^ (++inst->recovery.nonce << 16)));
+    esp01_exchange_t probe = {cmd, cmd_len, NULL, 0, ESP01_DEFAULT_TIMEOUT, esp01_discard_sink, NULL, 0, true, false,
+                              false};
+    esp01_rsp_status_t status = esp01_transfer(inst, &probe);
+    if (status != ESP01_RSP_OK && status != ESP01_RSP_ERROR) {
+        inst->recovery.stats.resync_failures++;
         return false;
     }
+    return true;
 }
 
-bool esp01_get_sleep_mode(esp01_inst_t *inst, esp01_sleep_mode_t *mode) {
-    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_SLEEP_CFG, "\n");
-
-    if (esp01_rsp_ok(rsp)) {
-        int m;
-
-        sscanf(rsp, "+SLEEP:%d", &m);
-
-        *mode = m;
-
-        free(rsp);
-        return true;
-    } else {
-        free(rsp);
+bool esp01_resync(esp01_inst_t *inst) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
         return false;
     }
-}
 
-bool esp01_set_sleep_mode(esp01_inst_t *inst, esp01_sleep_mode_t mode) {
-    char n[2];
+    bool synced = esp01_resync_locked(inst);
 
-    sprintf(n, "%d", mode);
+    esp01_unlock(inst);
+    return synced;
+}
 
-    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_SLEEP_CFG, n, "\n");
-    return esp01_rsp_ok_free(rsp);
+esp01_rsp_status_t esp01_get_last_status(esp01_inst_t *inst) {
+    return inst->last_status;
 }
 
-bool esp01_deep_sleep(esp01_inst_t *inst, uint duration) {
-    char cmd[ESP01_CMD_LENGTH + 1];
-    sprintf(cmd, "%u", duration);
+esp01_recovery_stats_t esp01_get_recovery_stats(esp01_inst_t *inst) {
+    return inst->recovery.stats;
+}
+
+// Count a failed attempt
+static void esp01_recovery_count(esp01_inst_t *inst, esp01_rsp_status_t status) {
+    esp01_recovery_t *recovery = &inst->recovery;
+
+    switch (status) {
+        case ESP01_RSP_TIMEOUT:
+            recovery->stats.timeouts++;
+            break;
+        case ESP01_RSP_BUSY:
+            recovery->stats.busy++;
+            inst->flow.stale = true;
+            break;
+        case ESP01_RSP_FRAMING:
+            recovery->stats.framing++;
+            break;
+        default:
+            break;
+    }
+}
+
+// Run an exchange while holding the instance lock
+static esp01_rsp_status_t esp01_exchange(esp01_inst_t *inst, esp01_exchange_t *ex) {
+    // Polling is skipped if someone else is using the device (it receives the unsolicited data)
+    esp01_cmd_properties_t properties = {NULL, ESP01_PRIORITY_LOW, false, false};
+    if (ex->cmd == NULL) {
+        if (!esp01_lock(inst, ESP01_PRIORITY_LOW, 0)) {
+            return ESP01_RSP_LOCK_TIMEOUT;
+        }
+    } else {
+        properties = esp01_cmd_properties_get(ex->cmd);
+        if (!esp01_lock(inst, properties.priority, inst->sched.timeout_ms)) {
+            inst->last_status = ESP01_RSP_LOCK_TIMEOUT;
+            return ESP01_RSP_LOCK_TIMEOUT;
+        }
+    }
+
+    // Commands with a payload are never sent twice, nor from an interrupt handler (no time to wait)
+    uint retries = 0;
+    if (properties.idempotent && ex->payload == NULL && __get_current_exception() == 0) {
+        retries = inst->recovery.max_retries;
+    }
+
+    // Adapt the timeout to the latency observed for this command (if it only depends on the device)
+    uint timeout_ms = ex->timeout_ms;
+    bool adaptive = properties.adaptive && inst->latency.adaptive;
+    uint32_t key = 0;
+    if (adaptive) {
+        key = esp01_latency_key(ex->cmd);
+    }
+
+    uint backoff_ms = inst->recovery.backoff_ms;
+    uint64_t start_us = time_us_64();
+    esp01_rsp_status_t status;
+    for (uint attempt = 0;; attempt++) {
+        uint64_t attempt_us = time_us_64();
+        if (adaptive) {
+            ex->timeout_ms = esp01_latency_timeout(&inst->latency, esp01_latency_find(inst, key), timeout_ms);
+        }
+
+        status = esp01_transfer(inst, ex);
+
+        // Busy and corrupted responses say nothing about the latency
+        if (adaptive && (status == ESP01_RSP_OK || status == ESP01_RSP_ERROR || status == ESP01_RSP_TIMEOUT)) {
+            esp01_latency_update(&inst->latency, key, status, ex->max_gap_us);
+        }
+
+        if (ex->cmd == NULL) {
+            break;
+        }
+        if (status == ESP01_RSP_OK || status == ESP01_RSP_ERROR || status == ESP01_RSP_UNWRITABLE) {
+            if (attempt > 0) {
+                inst->recovery.stats.recovered++;
+                inst->recovery.stats.time_lost_us += attempt_us - start_us;
+            }
+            break;
+        }
+
+        // A busy device is still in sync. Otherwise the late or corrupted data is drained, even if the command isn't
+        // sent again (a late OK would be taken for the response of the next command)
+        esp01_recovery_count(inst, status);
+        bool synced = status == ESP01_RSP_BUSY || esp01_resync_locked(inst);
+        if (attempt >= retries || !synced) {
+            if (attempt > 0 || status != ESP01_RSP_BUSY) {
+                inst->recovery.stats.time_lost_us += time_us_64() - start_us;
+            }
+            break;
+        }
+
+        ESP01_TRACE_EVENT(inst, ESP01_TRACE_RETRY);
+        inst->recovery.stats.retries++;
+        sleep_ms(backoff_ms);
+        backoff_ms *= 2;
+
+        // Drop the partial response
+        ex->sink(NULL, 0, ex->ctx);
+    }
+    ex->timeout_ms = timeout_ms;
+
+    if (ex->cmd != NULL) {
+        inst->last_status = status;
+    }
+
+    esp01_unlock(inst);
+    return status;
+}
+
+// Response buffer used by esp01_at_cmd
+struct esp01_rsp_buffer {
+    char *rsp;
+    size_t len;
+    bool overflow;
+} typedef esp01_rsp_buffer_t;
+
+// Sink concatenating the response in a buffer of ESP01_RSP_LENGTH bytes
+static bool esp01_rsp_buffer_sink(const char *chunk, size_t len, void *ctx) {
+    esp01_rsp_buffer_t *buf = ctx;
+
+    // Drop stale data
+    if (chunk == NULL) {
+        buf->len = 0;
+        buf->rsp[0] = '\0';
+        buf->overflow = false;
+        return true;
+    }
+
+    // Stop if the response overflows
+    if (buf->len + len >= ESP01_RSP_LENGTH) {
+        buf->overflow = true;
+        return false;
+    }
+
+    memcpy(buf->rsp + buf->len, chunk, len);
+    buf->len += len;
+    buf->rsp[buf->len] = '\0';
+    return true;
+}
+
+char *esp01_at_cmd(esp01_inst_t *inst, uint timeout_ms, char cmd_mode, const char *label, ...) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+
+    va_list args;
+    va_start(args, label);
+    size_t cmd_len = esp01_build_cmd(cmd, cmd_mode, label, args);
+    va_end(args);
+
+    // Return if the command overflows
+    if (cmd_len == 0) {
+        return NULL;
+    }
+
+    // Allocate memory for the device response
+    esp01_rsp_buffer_t buf = {malloc(ESP01_RSP_LENGTH + 1), 0, false};
+    buf.rsp[0] = '\0';
+
+    esp01_exchange_t ex = {cmd, cmd_len, NULL, 0, timeout_ms, esp01_rsp_buffer_sink, &buf, 0, false, false, false};
+    esp01_rsp_status_t status = esp01_exchange(inst, &ex);
+
+    if (status == ESP01_RSP_OK || status == ESP01_RSP_ERROR) {
+        // Append the termination word (the response is still complete and in sync)
+        char *word = status == ESP01_RSP_OK ? "OK\n" : "ERROR\n";
+        if (!buf.overflow && !esp01_rsp_buffer_sink(word, strlen(word), &buf)) {
+            buf.overflow = true;
+        }
+
+        if (!buf.overflow) {
+            // Reallocate to free memory
+            return realloc(buf.rsp, buf.len + 1);
+        }
+        ESP01_TRACE_EVENT(inst, ESP01_TRACE_OVERFLOW);
+        inst->recovery.stats.overflows++;
+        inst->last_status = ESP01_RSP_OVERFLOW;
+    }
+
+    free(buf.rsp);
+    return NULL;
+}
+
+esp01_rsp_status_t esp01_at_cmd_stream(esp01_inst_t *inst, uint timeout_ms, esp01_rsp_sink_t sink, void *ctx,
+                                       char cmd_mode, const char *label, ...) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+
+    va_list args;
+    va_start(args, label);
+    size_t cmd_len = esp01_build_cmd(cmd, cmd_mode, label, args);
+    va_end(args);
+
+    // Return if the command overflows
+    if (cmd_len == 0) {
+        return ESP01_RSP_CMD_OVERFLOW;
+    }
+
+    esp01_exchange_t ex = {cmd, cmd_len, NULL, 0, timeout_ms, sink, ctx, 0, false, false, false};
+    return esp01_exchange(inst, &ex);
+}
+
+void esp01_set_urc_handler(esp01_inst_t *inst, esp01_urc_handler_t handler, void *ctx) {
+    inst->urc_handler = handler;
+    inst->urc_ctx = ctx;
+}
+
+void esp01_poll(esp01_inst_t *inst, uint timeout_ms) {
+    esp01_exchange_t ex = {NULL, 0, NULL, 0, timeout_ms, esp01_discard_sink, NULL, 0, false, false, false};
+    esp01_exchange(inst, &ex);
+
+    // Send the coalesced data that waited long enough
+    if (inst->flow.pending_len > 0 &&
+        time_us_64() - inst->flow.pending_us >= ESP01_FLOW_COALESCE_DELAY * 1000 &&
+        esp01_lock(inst, ESP01_PRIORITY_HIGH, 0)) {
+        esp01_ip_flush(inst);
+        esp01_unlock(inst);
+    }
+}
+
+bool esp01_rsp_ok(char *rsp) {
+    // Return if it's the null pointer
+    if (rsp == NULL) {
+        return false;
+    }
+
+    // Check for OK
+    if (strstr(rsp, "\nOK\n") != NULL) {
+        return true;
+    }
+
+    // Fallback: return false (ERROR/malformed response)
+    return false;
+}
+
+bool esp01_rsp_ok_free(char *rsp) {
+    // Return if it's the null pointer
+    if (rsp == NULL) {
+        free(rsp);
+        return false;
+    }
+
+    // Check for OK
+    if (strstr(rsp, "\nOK\n") != NULL) {
+        free(rsp);
+        return true;
+    }
+
+    // Fallback: return false (ERROR/malformed response)
+    free(rsp);
+    return false;
+}
+
+uint esp01_trace_read(esp01_inst_t *inst, uint8_t *buf, uint max_len) {
+#if ESP01_TRACE_LEVEL > 0
+    // The ring is written by the exchanges, under the lock
+    if (!esp01_lock(inst, ESP01_PRIORITY_LOW, inst->sched.timeout_ms)) {
+        return 0;
+    }
+
+    esp01_trace_t *trace = &inst->trace;
+    uint len = 0;
+
+    // Copy whole records only
+    while (trace->used > 0) {
+        uint record_len = ESP01_TRACE_HEADER_LENGTH +
+                          trace->ring[(trace->tail + ESP01_TRACE_HEADER_LENGTH - 1) % ESP01_TRACE_RING_LENGTH];
+        if (len + record_len > max_len) {
+            break;
+        }
+
+        for (uint i = 0; i < record_len; i++) {
+            buf[len++] = trace->ring[(trace->tail + i) % ESP01_TRACE_RING_LENGTH];
+        }
+        esp01_trace_drop(trace);
+    }
+
+    esp01_unlock(inst);
+    return len;
+#else
+    return 0;
+#endif
+}
+
+void esp01_trace_dump(esp01_inst_t *inst) {
+#if ESP01_TRACE_LEVEL > 0
+    uint8_t records[ESP01_TRACE_HEADER_LENGTH + ESP01_TRACE_PAYLOAD_LENGTH];
+
+    // The records are printed without the lock, esp01_trace_read takes it for each batch
+    if (!esp01_lock(inst, ESP01_PRIORITY_LOW, inst->sched.timeout_ms)) {
+        return;
+    }
+    uint dropped = inst->trace.dropped;
+    inst->trace.dropped = 0;
+    esp01_unlock(inst);
+
+    if (dropped > 0) {
+        printf("(%u records dropped)\n", dropped);
+    }
+
+    uint len;
+    while ((len = esp01_trace_read(inst, records, sizeof(records))) > 0) {
+        for (uint8_t *record = records; record < records + len; record += ESP01_TRACE_HEADER_LENGTH + record[5]) {
+            uint32_t timestamp = record[0] | record[1] << 8 | record[2] << 16 | (uint32_t) record[3] << 24;
+            uint8_t *data = record + ESP01_TRACE_HEADER_LENGTH;
+
+            switch (record[4]) {
+                case ESP01_TRACE_EVENT:
+                    printf("[%10" PRIu32 "] ! %u\n", timestamp, data[0]);
+                    break;
+                case ESP01_TRACE_TX:
+                case ESP01_TRACE_RX:
+                    printf("[%10" PRIu32 "] %c ", timestamp, record[4] == ESP01_TRACE_TX ? '>' : '<');
+                    for (uint i = 0; i < record[5]; i++) {
+                        if (data[i] >= ' ' && data[i] <= '~') {
+                            putchar(data[i]);
+                        } else if (data[i] != '\n') {
+                            printf("\\x%02x", data[i]);
+                        }
+                    }
+                    putchar('\n');
+                    break;
+            }
+        }
+    }
+#endif
+}
+
+// Basic
+
+bool esp01_test(esp01_inst_t *inst) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_TEST, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_reset(esp01_inst_t *inst) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_RESET, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_get_version(esp01_inst_t *inst, esp01_version_t *ver) {
+    char *o_rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_VERSION, "\n");
+    char *rsp = o_rsp;
+
+    if (esp01_rsp_ok(rsp)) {
+        ver->at = malloc(ESP01_CMD_LENGTH + 1);
+        ver->sdk = malloc(ESP01_CMD_LENGTH + 1);
+        ver->bin = malloc(ESP01_CMD_LENGTH + 1);
+
+        *(ver->at) = *(ver->sdk) = *(ver->bin) = '\0';
+
+        sscanf(rsp, "AT version:%[^\n]", ver->at);
+        rsp = strstr(rsp, "\n") + 1;
+
+        sscanf(rsp, "SDK version:%[^\n]", ver->sdk);
+        rsp = strstr(rsp, "\n") + 1;
+
+        if (strstr(rsp, "\n") != NULL) {
+            rsp = strstr(rsp, "\n") + 1;
+        }
+
+        sscanf(rsp, "Bin version:%[^\n]", ver->bin);
+
+        free(o_rsp);
+        return true;
+    } else {
+        free(o_rsp);
+        return false;
+    }
+}
+
+bool esp01_get_sleep_mode(esp01_inst_t *inst, esp01_sleep_mode_t *mode) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_SLEEP_CFG, "\n");
+
+    if (esp01_rsp_ok(rsp)) {
+        int m;
+
+        sscanf(rsp, "+SLEEP:%d", &m);
+
+        *mode = m;
+
+        free(rsp);
+        return true;
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
+bool esp01_set_sleep_mode(esp01_inst_t *inst, esp01_sleep_mode_t mode) {
+    char n[2];
+
+    sprintf(n, "%d", mode);
+
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_SLEEP_CFG, n, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_deep_sleep(esp01_inst_t *inst, uint duration) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    sprintf(cmd, "%u", duration);
 
     char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_DEEP_SLEEP, cmd, "\n");
     return esp01_rsp_ok_free(rsp);
@@ -273,10 +1205,32 @@ bool esp01_factory_reset(esp01_inst_t *inst) {
     return esp01_rsp_ok_free(rsp);
 }
 
+bool esp01_get_sysram(esp01_inst_t *inst, esp01_sysram_t *ram) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_RAM, "\n");
+
+    // Older firmwares only report the free heap
+    int free_heap, min_heap = ESP01_UNDEFINED;
+    if (esp01_rsp_ok(rsp) && sscanf(rsp, "+SYSRAM:%d,%d", &free_heap, &min_heap) >= 1) {
+        ram->free = free_heap;
+        ram->min = min_heap;
+        free(rsp);
+        return true;
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
 bool esp01_get_uart_settings(esp01_inst_t *inst, esp01_uart_settings_t *uart_set, bool current) {
+    // The malformed responses are traced under the lock
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
+
     char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, current ? AT_UART_CURRENT : AT_UART_DEFAULT, "\n");
+    bool ok = esp01_rsp_ok(rsp);
 
-    if (esp01_rsp_ok(rsp)) {
+    if (ok) {
         uint parity;
         uint flow_control;
 
@@ -284,8 +1238,6 @@ bool esp01_get_uart_settings(esp01_inst_t *inst, esp01_uart_settings_t *uart_set
                &(uart_set->data_bits), &(uart_set->stop_bits),
                &parity, &flow_control);
 
-        free(rsp);
-
         switch (parity) {
             case 0:
                 uart_set->parity = UART_PARITY_NONE;
@@ -297,8 +1249,8 @@ bool esp01_get_uart_settings(esp01_inst_t *inst, esp01_uart_settings_t *uart_set
                 uart_set->parity = UART_PARITY_EVEN;
                 break;
             default:
-                printf("%u", parity);
-                return false;
+                ESP01_TRACE_EVENT(inst, ESP01_TRACE_MALFORMED);
+                ok = false;
         }
 
         switch (flow_control) {
@@ -319,14 +1271,16 @@ bool esp01_get_uart_settings(esp01_inst_t *inst, esp01_uart_settings_t *uart_set
                 uart_set->cts = true;
                 break;
             default:
-                return false;
+                if (ok) {
+                    ESP01_TRACE_EVENT(inst, ESP01_TRACE_MALFORMED);
+                }
+                ok = false;
         }
-
-        return true;
-    } else {
-        free(rsp);
-        return false;
     }
+
+    free(rsp);
+    esp01_unlock(inst);
+    return ok;
 }
 
 bool esp01_set_uart_settings(esp01_inst_t *inst, esp01_uart_settings_t uart_set, bool current) {
@@ -517,3 +1471,1266 @@ bool esp01_wifi_connect(esp01_inst_t *inst, esp01_connection_properties_t proper
     }
 }
 
+
+bool esp01_get_ap_config(esp01_inst_t *inst, esp01_ap_properties_t *properties) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_WIFI_AP_CFG, "\n");
+
+    if (esp01_rsp_ok(rsp)) {
+        int encryption;
+        *(properties->ssid) = *(properties->password) = '\0';
+
+        int rtn = sscanf(rsp, "+CWSAP:\"%32[^\"]\",\"%64[^\"]\",%d,%d,%d,%d", properties->ssid, properties->password,
+                         &(properties->channel), &encryption, &(properties->max_connections),
+                         &(properties->ssid_hidden));
+        properties->encryption = encryption;
+
+        free(rsp);
+        if (rtn < 4) {
+            return false;
+        } else {
+            return true;
+        }
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
+bool esp01_set_ap_config(esp01_inst_t *inst, esp01_ap_properties_t properties) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    int len = sprintf(cmd, "\"%s\",\"%s\",%d,%d", properties.ssid, properties.password, properties.channel,
+                      properties.encryption);
+
+    // The hidden flag comes after the maximum number of stations, which then keeps its configured value
+    int max_connections = properties.max_connections;
+    if (max_connections == ESP01_UNDEFINED && properties.ssid_hidden != ESP01_UNDEFINED) {
+        esp01_ap_properties_t current = ESP01_DEFAULT_AP_PROPERTIES;
+        if (!esp01_get_ap_config(inst, &current) || current.max_connections == ESP01_UNDEFINED) {
+            return false;
+        }
+        max_connections = current.max_connections;
+    }
+
+    if (max_connections != ESP01_UNDEFINED) {
+        len += sprintf(cmd + len, ",%d", max_connections);
+    }
+
+    if (properties.ssid_hidden != ESP01_UNDEFINED) {
+        sprintf(cmd + len, ",%d", properties.ssid_hidden);
+    }
+
+    char *rsp = esp01_at_cmd(inst, ESP01_EXTENDED_TIMEOUT, AT_SET, AT_WIFI_AP_CFG, cmd, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+// Station list being received
+struct esp01_station_list {
+    esp01_station_t *stations;
+    uint max_stations;
+    uint count;
+} typedef esp01_station_list_t;
+
+// Sink parsing +CWLIF lines
+static bool esp01_station_sink(const char *chunk, size_t len, void *ctx) {
+    esp01_station_list_t *list = ctx;
+
+    if (chunk == NULL) {
+        list->count = 0;
+        return true;
+    }
+
+    if (list->count < list->max_stations) {
+        esp01_station_t *station = &list->stations[list->count];
+        if (sscanf(chunk, "+CWLIF:%39[^,],%17[^\n]", station->ip, station->mac) == 2) {
+            list->count++;
+        }
+    }
+    return true;
+}
+
+bool esp01_get_ap_stations(esp01_inst_t *inst, esp01_station_t *stations, uint max_stations, uint *count) {
+    esp01_station_list_t list = {stations, max_stations, 0};
+
+    esp01_rsp_status_t status = esp01_at_cmd_stream(inst, ESP01_DEFAULT_TIMEOUT, esp01_station_sink, &list,
+                                                    AT_EXECUTE, AT_WIFI_AP_LIST_STATIONS, "\n");
+
+    *count = list.count;
+    return status == ESP01_RSP_OK;
+}
+
+// IP
+
+bool esp01_set_mux_mode(esp01_inst_t *inst, bool multiple) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_MUX_MODE, multiple ? "1" : "0", "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_get_dns(esp01_inst_t *inst, esp01_dns_properties_t *properties) {
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_IP_DNS, "\n");
+
+    if (esp01_rsp_ok(rsp)) {
+        int manual;
+        for (int i = 0; i < ESP01_DNS_SERVERS; i++) {
+            *(properties->servers[i]) = '\0';
+        }
+
+        int rtn = sscanf(rsp, "+CIPDNS:%d,\"%39[^\"]\",\"%39[^\"]\",\"%39[^\"]\"", &manual, properties->servers[0],
+                         properties->servers[1], properties->servers[2]);
+        properties->manual = manual;
+
+        free(rsp);
+        if (rtn < 1) {
+            return false;
+        } else {
+            return true;
+        }
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
+bool esp01_set_dns(esp01_inst_t *inst, esp01_dns_properties_t properties) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    int len = sprintf(cmd, "%d", properties.manual);
+
+    if (properties.manual) {
+        for (int i = 0; i < ESP01_DNS_SERVERS; i++) {
+            if (strlen(properties.servers[i]) != 0) {
+                len += sprintf(cmd + len, ",\"%s\"", properties.servers[i]);
+            }
+        }
+    }
+
+    // Names resolved by the previous servers are no longer relevant
+    esp01_flush_dns_cache(inst);
+
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_DNS, cmd, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_resolve(esp01_inst_t *inst, const char *host, char *ip) {
+    if (strlen(host) > ESP01_HOST_LENGTH) {
+        return false;
+    }
+
+    char cmd[ESP01_CMD_LENGTH + 1];
+    sprintf(cmd, "\"%s\"", host);
+
+    char *rsp = esp01_at_cmd(inst, ESP01_EXTENDED_TIMEOUT, AT_SET, AT_IP_DOMAIN, cmd, "\n");
+
+    if (esp01_rsp_ok(rsp)) {
+        // Depending on the firmware, the address may be quoted
+        int rtn = sscanf(rsp, "+CIPDOMAIN:\"%39[^\"]\"", ip);
+        if (rtn != 1) {
+            rtn = sscanf(rsp, "+CIPDOMAIN:%39[^\n]", ip);
+        }
+
+        free(rsp);
+        if (rtn != 1) {
+            return false;
+        } else {
+            return true;
+        }
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
+// Check if a host is an IP address literal
+static bool esp01_is_ip(const char *host) {
+    if (strchr(host, ':') != NULL) {
+        return true;
+    }
+
+    for (const char *c = host; *c != '\0'; c++) {
+        if ((*c < '0' || *c > '9') && *c != '.') {
+            return false;
+        }
+    }
+    return *host != '\0';
+}
+
+// Find the cache entry of a host (NULL if not found)
+static esp01_dns_entry_t *esp01_dns_find(esp01_inst_t *inst, const char *host) {
+    for (int i = 0; i < ESP01_DNS_CACHE_SIZE; i++) {
+        esp01_dns_entry_t *entry = &inst->dns_cache.entries[i];
+        if (entry->valid && strcmp(entry->host, host) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Store a resolution in the cache (replacing an expired or the least recently used entry)
+static void esp01_dns_store(esp01_inst_t *inst, const char *host, const char *ip, uint32_t now) {
+    esp01_dns_cache_t *cache = &inst->dns_cache;
+    uint ttl = ip != NULL ? cache->ttl_ms : cache->negative_ttl_ms;
+
+    if (ttl == 0 || strlen(host) > ESP01_HOST_LENGTH) {
+        return;
+    }
+
+    esp01_dns_entry_t *entry = esp01_dns_find(inst, host);
+    if (entry == NULL) {
+        entry = &cache->entries[0];
+        for (int i = 0; i < ESP01_DNS_CACHE_SIZE; i++) {
+            esp01_dns_entry_t *e = &cache->entries[i];
+            if (!e->valid || (int32_t) (e->expires_ms - now) <= 0) {
+                entry = e;
+                break;
+            }
+            if ((int32_t) (e->last_used_ms - entry->last_used_ms) < 0) {
+                entry = e;
+            }
+        }
+
+        if (entry->valid && (int32_t) (entry->expires_ms - now) > 0) {
+            cache->stats.evictions++;
+        }
+    }
+
+    entry->valid = true;
+    entry->negative = ip == NULL;
+    strcpy(entry->host, host);
+    strcpy(entry->ip, ip != NULL ? ip : "");
+    entry->expires_ms = now + ttl;
+    entry->last_used_ms = now;
+}
+
+bool esp01_dns_lookup(esp01_inst_t *inst, const char *host, char *ip) {
+    if (esp01_is_ip(host)) {
+        if (strlen(host) > ESP01_IP_LENGTH) {
+            return false;
+        }
+        strcpy(ip, host);
+        return true;
+    }
+
+    // The cache is shared by the callers
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    esp01_dns_cache_t *cache = &inst->dns_cache;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    bool found;
+
+    esp01_dns_entry_t *entry = esp01_dns_find(inst, host);
+    if (entry != NULL && (int32_t) (entry->expires_ms - now) > 0) {
+        entry->last_used_ms = now;
+        if (entry->negative) {
+            cache->stats.negative_hits++;
+            found = false;
+        } else {
+            cache->stats.hits++;
+            strcpy(ip, entry->ip);
+            found = true;
+        }
+    } else {
+        cache->stats.misses++;
+
+        // Only a resolution refused by the device is cached, not a transport failure
+        found = esp01_resolve(inst, host, ip);
+        if (found) {
+            esp01_dns_store(inst, host, ip, now);
+        } else if (esp01_get_last_status(inst) == ESP01_RSP_ERROR) {
+            esp01_dns_store(inst, host, NULL, now);
+        }
+    }
+
+    esp01_unlock(inst);
+    return found;
+}
+
+bool esp01_set_dns_cache_ttl(esp01_inst_t *inst, uint ttl_ms, uint negative_ttl_ms) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    inst->dns_cache.ttl_ms = ttl_ms;
+    inst->dns_cache.negative_ttl_ms = negative_ttl_ms;
+    for (int i = 0; i < ESP01_DNS_CACHE_SIZE; i++) {
+        inst->dns_cache.entries[i].valid = false;
+    }
+
+    esp01_unlock(inst);
+    return true;
+}
+
+bool esp01_flush_dns_cache(esp01_inst_t *inst) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    for (int i = 0; i < ESP01_DNS_CACHE_SIZE; i++) {
+        inst->dns_cache.entries[i].valid = false;
+    }
+
+    esp01_unlock(inst);
+    return true;
+}
+
+esp01_dns_stats_t esp01_get_dns_cache_stats(esp01_inst_t *inst) {
+    return inst->dns_cache.stats;
+}
+
+bool esp01_ip_connect(esp01_inst_t *inst, int link_id, esp01_ip_type_t type, const char *host, uint port) {
+    char ip[ESP01_IP_LENGTH + 1];
+    if (!esp01_dns_lookup(inst, host, ip)) {
+        return false;
+    }
+
+    char *type_str;
+    switch (type) {
+        case ESP01_IP_TCP:
+            type_str = "TCP";
+            break;
+        case ESP01_IP_UDP:
+            type_str = "UDP";
+            break;
+        case ESP01_IP_SSL:
+            type_str = "SSL";
+            break;
+        default:
+            return false;
+    }
+
+    char cmd[ESP01_CMD_LENGTH + 1];
+    if (link_id != ESP01_UNDEFINED) {
+        sprintf(cmd, "%d,\"%s\",\"%s\",%u", link_id, type_str, ip, port);
+    } else {
+        sprintf(cmd, "\"%s\",\"%s\",%u", type_str, ip, port);
+    }
+
+    if (!esp01_lock(inst, ESP01_PRIORITY_NORMAL, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    // The link is marked before the command, its CONNECT event is received along with the response
+    uint8_t link_bit = link_id >= 0 && link_id < ESP01_MAX_LINKS ? 1u << link_id : 0;
+    inst->client_links |= link_bit;
+
+    char *rsp = esp01_at_cmd(inst, ESP01_EXTENDED_TIMEOUT, AT_SET, AT_IP_START, cmd, "\n");
+
+    bool connected = esp01_rsp_ok_free(rsp);
+    if (connected) {
+        // Don't keep a connection without the requested options
+        esp01_socket_options_t *options = &inst->socket_options;
+        if (type != ESP01_IP_UDP && options->set != 0 && !esp01_set_socket_options(inst, link_id, *options)) {
+            esp01_ip_close(inst, link_id);
+            connected = false;
+        }
+    } else {
+        inst->client_links &= ~link_bit;
+
+        // The cached address may be stale, resolve it again next time
+        esp01_dns_entry_t *entry = esp01_dns_find(inst, host);
+        if (entry != NULL) {
+            entry->valid = false;
+        }
+    }
+
+    esp01_unlock(inst);
+    return connected;
+}
+
+// Socket options being received
+struct esp01_socket_options_query {
+    int link_id;
+    esp01_socket_options_t *options;
+    bool found;
+} typedef esp01_socket_options_query_t;
+
+// Sink parsing +CIPTCPOPT lines
+static bool esp01_socket_options_sink(const char *chunk, size_t len, void *ctx) {
+    esp01_socket_options_query_t *query = ctx;
+
+    if (chunk == NULL) {
+        query->found = false;
+        return true;
+    }
+
+    // The link ID comes first in both connection modes, the first link is taken in single connection mode
+    esp01_socket_options_t *options = query->options;
+    int link_id;
+    if (sscanf(chunk, "+CIPTCPOPT:%d,%d,%d,%d,%d", &link_id, &(options->so_linger), &(options->tcp_nodelay),
+               &(options->so_sndtimeo), &(options->keep_alive)) == 5 &&
+        (query->link_id == ESP01_UNDEFINED || link_id == query->link_id)) {
+        options->set = ESP01_SOCKET_ALL;
+        query->found = true;
+        return false;
+    }
+    return true;
+}
+
+bool esp01_get_socket_options(esp01_inst_t *inst, int link_id, esp01_socket_options_t *options) {
+    esp01_socket_options_query_t query = {link_id, options, false};
+
+    esp01_rsp_status_t status = esp01_at_cmd_stream(inst, ESP01_DEFAULT_TIMEOUT, esp01_socket_options_sink, &query,
+                                                    AT_QUERY, AT_IP_SOCKET_CFG, "\n");
+
+    return status == ESP01_RSP_OK && query.found;
+}
+
+bool esp01_set_socket_options(esp01_inst_t *inst, int link_id, esp01_socket_options_t options) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    int len = 0;
+
+    if (link_id != ESP01_UNDEFINED) {
+        len += sprintf(cmd, "%d,", link_id);
+    }
+
+    // Options not set are left empty, up to the last one set (the firmware refuses trailing empty fields)
+    int values[] = {options.so_linger, options.tcp_nodelay, options.so_sndtimeo, options.keep_alive};
+    int last = -1;
+    for (int i = 0; i < 4; i++) {
+        if (options.set & (1 << i)) {
+            last = i;
+        }
+    }
+    if (last < 0) {
+        return true;
+    }
+
+    for (int i = 0; i <= last; i++) {
+        if (i != 0) {
+            cmd[len++] = ',';
+        }
+        if (options.set & (1 << i)) {
+            len += sprintf(cmd + len, "%d", values[i]);
+        }
+    }
+    cmd[len] = '\0';
+
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SOCKET_CFG, cmd, "\n");
+    return esp01_rsp_ok_free(rsp);
+}
+
+void esp01_set_default_socket_options(esp01_inst_t *inst, esp01_socket_options_t options) {
+    inst->socket_options = options;
+}
+
+// Send data without flow control
+static bool esp01_ip_send_raw(esp01_inst_t *inst, int link_id, const char *data, size_t len) {
+    // Send the data in chunks accepted by the device
+    while (len > 0) {
+        size_t chunk_len = len < ESP01_SEND_LENGTH ? len : ESP01_SEND_LENGTH;
+
+        char cmd[ESP01_CMD_LENGTH + 1];
+        int cmd_len;
+        if (link_id != ESP01_UNDEFINED) {
+            cmd_len = sprintf(cmd, "%s=%d,%u\n", AT_IP_SEND, link_id, (uint) chunk_len);
+        } else {
+            cmd_len = sprintf(cmd, "%s=%u\n", AT_IP_SEND, (uint) chunk_len);
+        }
+
+        esp01_exchange_t ex = {cmd, cmd_len, data, chunk_len, ESP01_EXTENDED_TIMEOUT, esp01_discard_sink, NULL, 0,
+                               false, false, false};
+        if (esp01_exchange(inst, &ex) != ESP01_RSP_OK) {
+            return false;
+        }
+
+        data += chunk_len;
+        len -= chunk_len;
+    }
+
+    return true;
+}
+
+void esp01_set_flow_control(esp01_inst_t *inst, bool enabled, bool coalesce, uint low_watermark,
+                            uint high_watermark, uint interval_ms) {
+    inst->flow.enabled = enabled;
+    inst->flow.coalesce = coalesce;
+    inst->flow.low_watermark = low_watermark;
+    inst->flow.high_watermark = high_watermark;
+    inst->flow.interval_ms = interval_ms;
+    inst->flow.sampled_us = 0;
+    inst->flow.free = ESP01_UNDEFINED;
+}
+
+esp01_flow_stats_t esp01_get_flow_stats(esp01_inst_t *inst) {
+    return inst->flow.stats;
+}
+
+// Sample the device free heap if the last sample is too old or the device answered busy since
+static void esp01_flow_sample(esp01_inst_t *inst, bool force) {
+    esp01_flow_t *flow = &inst->flow;
+    uint64_t now_us = time_us_64();
+    if (!force && !flow->stale && flow->free != ESP01_UNDEFINED &&
+        now_us - flow->sampled_us < (uint64_t) flow->interval_ms * 1000) {
+        return;
+    }
+
+    if (flow->stale) {
+        flow->stats.busy_samples++;
+    }
+    flow->stale = false;
+
+    esp01_sysram_t ram;
+    if (!esp01_get_sysram(inst, &ram)) {
+        esp01_rsp_status_t status = esp01_get_last_status(inst);
+        if (status == ESP01_RSP_BUSY) {
+            // A busy device is assumed to be short on heap
+            flow->free = 0;
+        } else if (status == ESP01_RSP_ERROR) {
+            // The firmware doesn't know the command
+            flow->supported = false;
+        }
+        flow->sampled_us = now_us;
+        return;
+    }
+
+    flow->free = ram.free;
+    flow->sampled_us = now_us;
+    flow->stats.samples++;
+    flow->stats.last_free = ram.free;
+    flow->stats.last_min = ram.min;
+    if (flow->stats.lowest_free == ESP01_UNDEFINED || ram.free < flow->stats.lowest_free) {
+        flow->stats.lowest_free = ram.free;
+    }
+}
+
+// Send the pending data (the caller holds the lock)
+static bool esp01_flow_flush(esp01_inst_t *inst) {
+    esp01_flow_t *flow = &inst->flow;
+    if (flow->pending_len == 0) {
+        return true;
+    }
+
+    bool sent = esp01_ip_send_raw(inst, flow->pending_link, flow->pending, flow->pending_len);
+    if (sent) {
+        flow->stats.flushes++;
+    } else {
+        flow->stats.dropped += flow->pending_len;
+    }
+    flow->pending_len = 0;
+    return sent;
+}
+
+bool esp01_ip_flush(esp01_inst_t *inst) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    bool sent = esp01_flow_flush(inst);
+
+    esp01_unlock(inst);
+    return sent;
+}
+
+// Send data with flow control, datagrams are never coalesced (the caller holds the lock)
+static bool esp01_flow_send(esp01_inst_t *inst, int link_id, const char *data, size_t len, bool datagram) {
+    esp01_flow_t *flow = &inst->flow;
+
+    // The pending data goes first
+    if (flow->pending_len > 0 &&
+        (datagram || flow->pending_link != link_id || flow->pending_len + len > ESP01_SEND_LENGTH)) {
+        if (!esp01_flow_flush(inst)) {
+            return false;
+        }
+    }
+
+    if (!flow->enabled || !flow->supported) {
+        return esp01_flow_flush(inst) && esp01_ip_send_raw(inst, link_id, data, len);
+    }
+
+    esp01_flow_sample(inst, false);
+
+    // Wait for the device to free its heap (not from an interrupt handler). The wait has its own bound, as the other
+    // tasks wait for the instance meanwhile.
+    if (flow->supported && flow->free != ESP01_UNDEFINED && flow->free < (int) flow->low_watermark) {
+        flow->stats.throttles++;
+        uint64_t start_us = time_us_64();
+        while (flow->supported && flow->free < (int) flow->low_watermark) {
+            if (__get_current_exception() != 0 || time_us_64() - start_us >= ESP01_FLOW_THROTTLE_TIMEOUT * 1000) {
+                flow->stats.throttle_timeouts++;
+                flow->stats.throttle_us += time_us_64() - start_us;
+                return false;
+            }
+            sleep_ms(ESP01_FLOW_POLL_INTERVAL);
+            esp01_flow_sample(inst, true);
+        }
+        flow->stats.throttle_us += time_us_64() - start_us;
+    }
+
+    // Coalesce the small sends while the heap is low (each send holds device buffers)
+    if (!datagram && flow->coalesce && flow->supported && flow->free != ESP01_UNDEFINED && flow->free < (int) flow->high_watermark &&
+        flow->pending_len + len <= ESP01_SEND_LENGTH) {
+        if (flow->pending == NULL) {
+            flow->pending = malloc(ESP01_SEND_LENGTH);
+        }
+        if (flow->pending_len == 0) {
+            flow->pending_link = link_id;
+            flow->pending_us = time_us_64();
+        } else {
+            flow->stats.coalesced++;
+        }
+        memcpy(flow->pending + flow->pending_len, data, len);
+        flow->pending_len += len;
+        return true;
+    }
+
+    // The heap recovered, the data is sent along with the pending data
+    if (flow->pending_len > 0) {
+        memcpy(flow->pending + flow->pending_len, data, len);
+        flow->pending_len += len;
+        flow->stats.coalesced++;
+        return esp01_flow_flush(inst);
+    }
+
+    return esp01_ip_send_raw(inst, link_id, data, len);
+}
+
+bool esp01_ip_send(esp01_inst_t *inst, int link_id, const char *data, size_t len) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    bool sent = esp01_flow_send(inst, link_id, data, len, false);
+
+    esp01_unlock(inst);
+    return sent;
+}
+
+// Open a frame, the data is then written by the caller until the terminator (the caller holds the lock)
+static bool esp01_send_stream_open(esp01_send_stream_t *stream) {
+    char cmd[ESP01_CMD_LENGTH + 1];
+    int cmd_len;
+    if (stream->link_id != ESP01_UNDEFINED) {
+        cmd_len = sprintf(cmd, "%s=%d,%u\n", AT_IP_SEND_EX, stream->link_id, (uint) ESP01_SEND_LENGTH);
+    } else {
+        cmd_len = sprintf(cmd, "%s=%u\n", AT_IP_SEND_EX, (uint) ESP01_SEND_LENGTH);
+    }
+
+    esp01_exchange_t ex = {cmd, cmd_len, NULL, 0, ESP01_DEFAULT_TIMEOUT, esp01_discard_sink, NULL, 0, false, true,
+                           false};
+    stream->frame_len = 0;
+    stream->open = esp01_exchange(stream->inst, &ex) == ESP01_RSP_OK;
+    if (stream->open) {
+        stream->frames++;
+    }
+    return stream->open;
+}
+
+// Terminate the frame and wait for the device to send it
+static bool esp01_send_stream_close(esp01_send_stream_t *stream) {
+    esp01_inst_t *inst = stream->inst;
+    stream->open = false;
+
+    ESP01_TRACE_TX(inst, "\\0", 2);
+    uart_putc_raw(inst->uart_inst, '\\');
+    uart_putc_raw(inst->uart_inst, '0');
+
+    esp01_exchange_t ex = {NULL, 0, NULL, 0, ESP01_EXTENDED_TIMEOUT, esp01_discard_sink, NULL, 0, false, false,
+                           true};
+    return esp01_exchange(inst, &ex) == ESP01_RSP_OK;
+}
+
+bool esp01_ip_send_begin(esp01_inst_t *inst, esp01_send_stream_t *stream, int link_id) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    stream->inst = inst;
+    stream->link_id = link_id;
+    stream->len = 0;
+    stream->frames = 0;
+
+    // The coalesced data was sent before (dropped if it fails)
+    esp01_flow_flush(inst);
+
+    if (!esp01_send_stream_open(stream)) {
+        esp01_unlock(inst);
+        return false;
+    }
+    return true;
+}
+
+bool esp01_ip_send_write(esp01_send_stream_t *stream, const char *data, size_t len) {
+    esp01_inst_t *inst = stream->inst;
+    if (!stream->open) {
+        return false;
+    }
+
+    ESP01_TRACE_TX(inst, data, len);
+    for (const char *c = data; c < data + len; c++) {
+        // Send the frame when it is full (keeping room for an escape and the terminator) and open another one
+        if (stream->frame_len + 4 > ESP01_SEND_LENGTH) {
+            if (!esp01_send_stream_close(stream) || !esp01_send_stream_open(stream)) {
+                stream->open = false;
+                esp01_unlock(inst);
+                return false;
+            }
+        }
+
+        // Escape the backslashes so that the data can't end the frame
+        if (*c == '\\') {
+            uart_putc_raw(inst->uart_inst, '\\');
+            stream->frame_len++;
+        }
+        uart_putc_raw(inst->uart_inst, *c);
+        stream->frame_len++;
+    }
+
+    stream->len += len;
+    return true;
+}
+
+bool esp01_ip_send_end(esp01_send_stream_t *stream) {
+    // The instance was already unlocked if a write failed
+    if (!stream->open) {
+        return false;
+    }
+
+    bool sent = esp01_send_stream_close(stream);
+
+    esp01_unlock(stream->inst);
+    return sent;
+}
+
+bool esp01_ip_close(esp01_inst_t *inst, int link_id) {
+    if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
+        return false;
+    }
+
+    // The pending data of the link is sent before closing it
+    if (inst->flow.pending_len > 0 && (link_id == ESP01_UNDEFINED || inst->flow.pending_link == link_id)) {
+        esp01_flow_flush(inst);
+    }
+
+    char *rsp;
+    if (link_id != ESP01_UNDEFINED) {
+        char cmd[12];
+        sprintf(cmd, "%d", link_id);
+        rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_CLOSE, cmd, "\n");
+        if (link_id >= 0 && link_id < ESP01_MAX_LINKS) {
+            inst->client_links &= ~(1u << link_id);
+        }
+    } else {
+        rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_IP_CLOSE, "\n");
+    }
+
+    esp01_unlock(inst);
+    return esp01_rsp_ok_free(rsp);
+}
+
+bool esp01_ping(esp01_inst_t *inst, const char *host, uint *rtt_ms) {
+    if (strlen(host) > ESP01_HOST_LENGTH) {
+        return false;
+    }
+
+    char cmd[ESP01_CMD_LENGTH + 1];
+    sprintf(cmd, "\"%s\"", host);
+
+    char *rsp = esp01_at_cmd(inst, ESP01_EXTENDED_TIMEOUT, AT_SET, AT_IP_PING, cmd, "\n");
+
+    if (esp01_rsp_ok(rsp)) {
+        int rtn = sscanf(rsp, "+PING:%u", rtt_ms);
+
+        free(rsp);
+        if (rtn != 1) {
+            return false;
+        } else {
+            return true;
+        }
+    } else {
+        free(rsp);
+        return false;
+    }
+}
+
+// Probe
+
+esp01_probe_t *esp01_probe_init(esp01_inst_t *inst, uint interval_ms) {
+    esp01_probe_t *probe = malloc(sizeof(esp01_probe_t));
+    memset(probe, 0, sizeof(esp01_probe_t));
+
+    probe->inst = inst;
+    probe->interval_ms = interval_ms;
+    probe->next_ms = to_ms_since_boot(get_absolute_time());
+    probe->rssi = ESP01_UNDEFINED;
+    probe->channel = ESP01_UNDEFINED;
+
+    return probe;
+}
+
+void esp01_probe_deinit(esp01_probe_t *probe) {
+    free(probe);
+}
+
+int esp01_probe_add_host(esp01_probe_t *probe, const char *host) {
+    if (probe->host_count == ESP01_PROBE_MAX_HOSTS || strlen(host) > ESP01_HOST_LENGTH) {
+        return ESP01_UNDEFINED;
+    }
+
+    strcpy(probe->hosts[probe->host_count], host);
+    return probe->host_count++;
+}
+
+bool esp01_probe_poll(esp01_probe_t *probe) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (probe->host_count == 0 || (int32_t) (probe->next_ms - now) > 0) {
+        return false;
+    }
+    probe->next_ms = now + probe->interval_ms;
+
+    // Sample the radio once per round
+    if (probe->next_host == 0) {
+        esp01_connection_properties_t properties = ESP01_DEFAULT_CONNECTION_PROPERTIES;
+        if (esp01_get_wifi_connection(probe->inst, &properties)) {
+            probe->rssi = properties.rssi;
+            probe->channel = properties.channel;
+        }
+    }
+
+    esp01_probe_sample_t *sample = &probe->samples[probe->head];
+    sample->host = probe->next_host;
+    sample->timeout = !esp01_ping(probe->inst, probe->hosts[probe->next_host], &sample->rtt_ms);
+    sample->timestamp_ms = now;
+    sample->rssi = probe->rssi;
+    sample->channel = probe->channel;
+
+    probe->head = (probe->head + 1) % ESP01_PROBE_RING_LENGTH;
+    if (probe->count < ESP01_PROBE_RING_LENGTH) {
+        probe->count++;
+    }
+    probe->next_host = (probe->next_host + 1) % probe->host_count;
+
+    return true;
+}
+
+bool esp01_probe_get_stats(esp01_probe_t *probe, uint host, int channel, esp01_probe_stats_t *stats) {
+    uint rtts[ESP01_PROBE_RING_LENGTH];
+    float sum_rtt = 0;
+
+    // RSSI sums, over the samples with a RSSI only
+    float sum_rssi_rtt = 0, sum_rssi = 0, sum_rtt2 = 0, sum_rssi2 = 0, sum_rtt_rssi = 0;
+
+    memset(stats, 0, sizeof(esp01_probe_stats_t));
+
+    for (uint i = 0; i < probe->count; i++) {
+        esp01_probe_sample_t *sample = &probe->samples[i];
+        if (sample->host != host || (channel != ESP01_UNDEFINED && sample->channel != channel)) {
+            continue;
+        }
+
+        if (sample->timeout) {
+            stats->timeouts++;
+            continue;
+        }
+
+        // Insertion sort (for the percentile)
+        uint j = stats->count;
+        while (j > 0 && rtts[j - 1] > sample->rtt_ms) {
+            rtts[j] = rtts[j - 1];
+            j--;
+        }
+        rtts[j] = sample->rtt_ms;
+        stats->count++;
+
+        sum_rtt += sample->rtt_ms;
+
+        // The RSSI is unknown until the first successful radio query
+        if (sample->rssi == ESP01_UNDEFINED) {
+            continue;
+        }
+        stats->rssi_count++;
+        sum_rssi_rtt += sample->rtt_ms;
+        sum_rssi += sample->rssi;
+        sum_rtt2 += (float) sample->rtt_ms * sample->rtt_ms;
+        sum_rssi2 += (float) sample->rssi * sample->rssi;
+        sum_rtt_rssi += (float) sample->rtt_ms * sample->rssi;
+    }
+
+    if (stats->count == 0) {
+        return stats->timeouts != 0;
+    }
+
+    float n = stats->count;
+    stats->min_ms = rtts[0];
+    stats->max_ms = rtts[stats->count - 1];
+    stats->p95_ms = rtts[(stats->count * 95 + 99) / 100 - 1];
+    stats->avg_ms = sum_rtt / n + 0.5f;
+
+    stats->avg_rssi = ESP01_UNDEFINED;
+    if (stats->rssi_count == 0) {
+        return true;
+    }
+    n = stats->rssi_count;
+    stats->avg_rssi = lroundf(sum_rssi / n);
+
+    // Pearson correlation between RTT and RSSI (0 if one of them doesn't vary)
+    float var_rtt = n * sum_rtt2 - sum_rssi_rtt * sum_rssi_rtt;
+    float var_rssi = n * sum_rssi2 - sum_rssi * sum_rssi;
+    if (var_rtt > 0 && var_rssi > 0) {
+        stats->rtt_rssi_correlation = (n * sum_rtt_rssi - sum_rssi_rtt * sum_rssi) / sqrtf(var_rtt * var_rssi);
+    }
+
+    return true;
+}
+
+uint esp01_probe_get_samples(esp01_probe_t *probe, esp01_probe_sample_t *samples, uint max_samples) {
+    uint count = probe->count < max_samples ? probe->count : max_samples;
+    uint start = (probe->head + ESP01_PROBE_RING_LENGTH - count) % ESP01_PROBE_RING_LENGTH;
+
+    for (uint i = 0; i < count; i++) {
+        samples[i] = probe->samples[(start + i) % ESP01_PROBE_RING_LENGTH];
+    }
+
+    return count;
+}
+
+// Server
+
+// Remove bytes from the buffer of a connection (the offsets of the events received after them are shifted)
+static void esp01_server_cut(esp01_server_conn_t *conn, size_t start, size_t len) {
+    memmove(conn->buffer + start, conn->buffer + start + len, conn->len - start - len);
+    conn->len -= len;
+    for (uint i = 0; i < conn->event_count; i++) {
+        if (conn->events[i].offset >= start + len) {
+            conn->events[i].offset -= len;
+        }
+    }
+}
+
+// Drop the oldest connection opened and closed since the last poll (it is never dispatched) to make room in the queue
+static bool esp01_server_collapse(esp01_server_t *server, esp01_server_conn_t *conn) {
+    for (uint i = 0; i + 1 < conn->event_count; i++) {
+        if (conn->events[i].urc != ESP01_URC_CONNECT || conn->events[i + 1].urc != ESP01_URC_CLOSED) {
+            continue;
+        }
+
+        size_t start = conn->events[i].offset;
+        size_t len = conn->events[i + 1].offset - start;
+        conn->event_count -= 2;
+        memmove(&conn->events[i], &conn->events[i + 2], (conn->event_count - i) * sizeof(esp01_server_event_t));
+        esp01_server_cut(conn, start, len);
+
+        server->stats.missed++;
+        server->stats.dropped_bytes += len;
+        return true;
+    }
+    return false;
+}
+
+// Store server events in the connection pool (handlers are called later from esp01_server_poll)
+static void esp01_server_urc_handler(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len,
+                                     void *ctx) {
+    esp01_server_t *server = ctx;
+
+    // The links opened by the driver itself aren't server connections
+    if (link_id >= 0 && link_id < ESP01_MAX_LINKS && (inst->client_links & (1u << link_id))) {
+        if (server->next_handler != NULL) {
+            server->next_handler(inst, urc, link_id, data, len, server->next_ctx);
+        }
+        return;
+    }
+
+    if (link_id < 0 || link_id >= ESP01_SERVER_MAX_CONNECTIONS) {
+        if (urc == ESP01_URC_DATA) {
+            server->stats.dropped_bytes += len;
+        }
+        return;
+    }
+
+    esp01_server_conn_t *conn = &server->conns[link_id];
+
+    switch (urc) {
+        case ESP01_URC_CONNECT:
+        case ESP01_URC_CLOSED:
+            // The device alternates connects and closes, so a full queue always holds a whole connection
+            if (conn->event_count == ESP01_SERVER_EVENT_QUEUE_LENGTH && !esp01_server_collapse(server, conn)) {
+                return;
+            }
+            conn->events[conn->event_count].urc = urc;
+            conn->events[conn->event_count].offset = conn->len;
+            conn->event_count++;
+            break;
+        case ESP01_URC_DATA:
+            if (conn->len + len > ESP01_SERVER_BUFFER_LENGTH) {
+                server->stats.dropped_bytes += conn->len + len - ESP01_SERVER_BUFFER_LENGTH;
+                len = ESP01_SERVER_BUFFER_LENGTH - conn->len;
+            }
+            memcpy(conn->buffer + conn->len, data, len);
+            conn->len += len;
+            server->stats.rx_bytes += len;
+            break;
+    }
+}
+
+esp01_server_t *esp01_server_init(esp01_inst_t *inst, uint port, uint max_connections, uint timeout_s) {
+    if (max_connections == 0 || max_connections > ESP01_SERVER_MAX_CONNECTIONS) {
+        return NULL;
+    }
+
+    char cmd[ESP01_CMD_LENGTH + 1];
+
+    // The maximum number of connections must be set before creating the server
+    if (!esp01_set_mux_mode(inst, true)) {
+        return NULL;
+    }
+
+    sprintf(cmd, "%u", max_connections);
+    if (!esp01_rsp_ok_free(esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SERVER_MAX_CONNECTIONS, cmd, "\n"))) {
+        return NULL;
+    }
+
+    sprintf(cmd, "1,%u", port);
+    if (!esp01_rsp_ok_free(esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SERVER, cmd, "\n"))) {
+        return NULL;
+    }
+
+    sprintf(cmd, "%u", timeout_s);
+    if (!esp01_rsp_ok_free(esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SERVER_TIMEOUT, cmd, "\n"))) {
+        esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SERVER, "0,1", "\n");
+        return NULL;
+    }
+
+    esp01_server_t *server = malloc(sizeof(esp01_server_t));
+    memset(server, 0, sizeof(esp01_server_t));
+
+    server->inst = inst;
+    server->port = port;
+    server->max_connections = max_connections;
+
+    for (int i = 0; i < ESP01_SERVER_MAX_CONNECTIONS; i++) {
+        server->conns[i].link_id = i;
+    }
+
+    server->next_handler = inst->urc_handler;
+    server->next_ctx = inst->urc_ctx;
+    esp01_set_urc_handler(inst, esp01_server_urc_handler, server);
+
+    return server;
+}
+
+void esp01_server_deinit(esp01_server_t *server) {
+    // Delete the server and close all connections
+    free(esp01_at_cmd(server->inst, ESP01_DEFAULT_TIMEOUT, AT_SET, AT_IP_SERVER, "0,1", "\n"));
+
+    esp01_set_urc_handler(server->inst, server->next_handler, server->next_ctx);
+
+    free(server);
+}
+
+void esp01_server_set_handlers(esp01_server_t *server, esp01_server_event_handler_t on_connect,
+                               esp01_server_data_handler_t on_data, esp01_server_event_handler_t on_close, void *ctx) {
+    server->on_connect = on_connect;
+    server->on_data = on_data;
+    server->on_close = on_close;
+    server->ctx = ctx;
+}
+
+// Hand the first bytes of the buffer to the data handler (dropped if the connection isn't active, the unconsumed
+// ones are dropped too if the connection ends there)
+static void esp01_server_dispatch(esp01_server_t *server, esp01_server_conn_t *conn, size_t len, bool last) {
+    if (len == 0) {
+        return;
+    }
+
+    if (!conn->active) {
+        server->stats.dropped_bytes += len;
+        esp01_server_cut(conn, 0, len);
+        return;
+    }
+
+    // Data and events can be received while the handler runs, they are stored after these bytes
+    size_t consumed = len;
+    if (server->on_data != NULL) {
+        consumed = server->on_data(server, conn, conn->buffer, len, server->ctx);
+        if (consumed > len) {
+            consumed = len;
+        }
+    }
+
+    // Drop the data if the buffer is full and the handler can't consume it
+    if (last || (consumed == 0 && conn->len == ESP01_SERVER_BUFFER_LENGTH)) {
+        server->stats.dropped_bytes += len - consumed;
+        consumed = len;
+    }
+
+    esp01_server_cut(conn, 0, consumed);
+}
+
+// End the current connection of a link
+static void esp01_server_end(esp01_server_t *server, esp01_server_conn_t *conn) {
+    if (conn->active) {
+        if (server->on_close != NULL) {
+            server->on_close(server, conn, server->ctx);
+        }
+        server->stats.closed++;
+    }
+
+    conn->active = false;
+    conn->user = NULL;
+}
+
+void esp01_server_poll(esp01_server_t *server, uint timeout_ms) {
+    // The connection pool is filled by the receive loop of any caller
+    if (!esp01_lock(server->inst, ESP01_PRIORITY_NORMAL, server->inst->sched.timeout_ms)) {
+        return;
+    }
+
+    esp01_poll(server->inst, timeout_ms);
+
+    for (int i = 0; i < ESP01_SERVER_MAX_CONNECTIONS; i++) {
+        esp01_server_conn_t *conn = &server->conns[i];
+
+        // Dispatch the events in reception order, each one after the data received before it
+        while (conn->event_count > 0) {
+            esp01_server_dispatch(server, conn, conn->events[0].offset, true);
+
+            esp01_urc_t urc = conn->events[0].urc;
+            conn->event_count--;
+            memmove(&conn->events[0], &conn->events[1], conn->event_count * sizeof(esp01_server_event_t));
+
+            // A connect without the close of the previous connection also ends it
+            esp01_server_end(server, conn);
+            if (urc != ESP01_URC_CONNECT) {
+                continue;
+            }
+
+            // The device accepts link IDs outside of the pool when it was configured by someone else
+            if (i >= (int) server->max_connections) {
+                server->stats.rejected++;
+                esp01_ip_close(server->inst, i);
+                continue;
+            }
+
+            conn->active = true;
+            server->stats.accepted++;
+            if (server->on_connect != NULL) {
+                server->on_connect(server, conn, server->ctx);
+            }
+        }
+
+        esp01_server_dispatch(server, conn, conn->len, false);
+    }
+
+    esp01_unlock(server->inst);
+}
+
+bool esp01_server_close(esp01_server_t *server, esp01_server_conn_t *conn) {
+    return esp01_ip_close(server->inst, conn->link_id);
+}
+
+// Telemetry
+
+esp01_telemetry_t *esp01_telemetry_init(esp01_inst_t *inst, int link_id, const char *host, uint port,
+                                        uint deadline_ms) {
+    if (!esp01_ip_connect(inst, link_id, ESP01_IP_UDP, host, port)) {
+        return NULL;
+    }
+
+    esp01_telemetry_t *telemetry = malloc(sizeof(esp01_telemetry_t));
+    memset(telemetry, 0, sizeof(esp01_telemetry_t));
+
+    telemetry->inst = inst;
+    telemetry->link_id = link_id;
+    telemetry->deadline_ms = deadline_ms;
+    telemetry->lock = spin_lock_instance(next_striped_spin_lock_num());
+
+    return telemetry;
+}
+
+void esp01_telemetry_deinit(esp01_telemetry_t *telemetry) {
+    // Send the full datagram, then the one being filled
+    esp01_telemetry_poll(telemetry, true);
+    esp01_telemetry_poll(telemetry, true);
+
+    esp01_ip_close(telemetry->inst, telemetry->link_id);
+
+    free(telemetry);
+}
+
+bool esp01_telemetry_push(esp01_telemetry_t *telemetry, const void *sample, size_t len) {
+    uint32_t save = spin_lock_blocking(telemetry->lock);
+
+    esp01_telemetry_buffer_t *buffer = &telemetry->buffers[telemetry->fill];
+    if (buffer->len + len > ESP01_TELEMETRY_MTU) {
+        // Switch to the other buffer if it was sent
+        if (telemetry->full || len > ESP01_TELEMETRY_MTU) {
+            telemetry->stats.dropped++;
+            spin_unlock(telemetry->lock, save);
+            return false;
+        }
+        telemetry->fill ^= 1;
+        telemetry->full = true;
+        buffer = &telemetry->buffers[telemetry->fill];
+    }
+
+    if (buffer->samples == 0) {
+        buffer->first_us = time_us_64();
+    }
+    memcpy(buffer->data + buffer->len, sample, len);
+    buffer->len += len;
+    buffer->samples++;
+
+    spin_unlock(telemetry->lock, save);
+    return true;
+}
+
+bool esp01_telemetry_poll(esp01_telemetry_t *telemetry, bool force) {
+    uint32_t save = spin_lock_blocking(telemetry->lock);
+
+    // Switch the buffers if the datagram being filled reached its deadline
+    esp01_telemetry_buffer_t *fill = &telemetry->buffers[telemetry->fill];
+    if (!telemetry->full && fill->samples > 0 &&
+        (force || time_us_64() - fill->first_us >= (uint64_t) telemetry->deadline_ms * 1000)) {
+        telemetry->fill ^= 1;
+        telemetry->full = true;
+    }
+    bool full = telemetry->full;
+
+    spin_unlock(telemetry->lock, save);
+
+    if (!full) {
+        return false;
+    }
+
+    // The full buffer isn't touched by esp01_telemetry_push until it is released
+    esp01_telemetry_buffer_t *buffer = &telemetry->buffers[telemetry->fill ^ 1];
+    bool sent = false;
+    if (esp01_lock(telemetry->inst, ESP01_PRIORITY_HIGH, telemetry->inst->sched.timeout_ms)) {
+        sent = esp01_flow_send(telemetry->inst, telemetry->link_id, buffer->data, buffer->len, true);
+        esp01_unlock(telemetry->inst);
+    }
+    uint64_t latency_us = time_us_64() - buffer->first_us;
+
+    save = spin_lock_blocking(telemetry->lock);
+
+    esp01_telemetry_stats_t *stats = &telemetry->stats;
+    if (sent) {
+        if (stats->datagrams == 0 || buffer->samples < stats->min_batch) {
+            stats->min_batch = buffer->samples;
+        }
+        if (buffer->samples > stats->max_batch) {
+            stats->max_batch = buffer->samples;
+        }
+        stats->datagrams++;
+        stats->samples += buffer->samples;
+        stats->total_latency_us += latency_us;
+        if (latency_us > stats->max_latency_us) {
+            stats->max_latency_us = latency_us;
+        }
+    } else {
+        stats->send_failures++;
+        stats->dropped += buffer->samples;
+    }
+
+    buffer->len = 0;
+    buffer->samples = 0;
+    telemetry->full = false;
+
+    spin_unlock(telemetry->lock, save);
+    return sent;
+}
+
+esp01_telemetry_stats_t esp01_telemetry_get_stats(esp01_telemetry_t *telemetry) {
+    uint32_t save = spin_lock_blocking(telemetry->lock);
+    esp01_telemetry_stats_t stats = telemetry->stats;
+    spin_unlock(telemetry->lock, save);
+    return stats;
+}
@@ -1,17 +1,41 @@
 #ifndef _PICO_ESP01_H
 #define _PICO_ESP01_H
 
+#include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <math.h>
 
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "pico/malloc.h"
+#include "pico/lock_core.h"
+#include "pico/platform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define ESP01_UNDEFINED (-1)
 
+// Trace levels (set ESP01_TRACE_LEVEL at compile time, 0 disables the trace)
+#define ESP01_TRACE_LEVEL_EVENTS 1
+#define ESP01_TRACE_LEVEL_TX 2
+#define ESP01_TRACE_LEVEL_RX 3
+
+#ifndef ESP01_TRACE_LEVEL
+#define ESP01_TRACE_LEVEL 0
+#endif
+
+#ifndef ESP01_TRACE_RING_LENGTH
+#define ESP01_TRACE_RING_LENGTH 2048
+#endif
+#define ESP01_TRACE_HEADER_LENGTH 6
+#define ESP01_TRACE_PAYLOAD_LENGTH 255
+
 #define ESP01_DEFAULT_BAUD_RATE 115273
 #define ESP01_DEFAULT_DATA_BITS 8
 #define ESP01_DEFAULT_STOP_BITS 1
@@ -20,13 +44,46 @@
 #define ESP01_DEFAULT_RTS true
 #define ESP01_SSID_LENGTH 32
 #define ESP01_MAC_LENGTH 17
+#define ESP01_IP_LENGTH 39
+#define ESP01_HOST_LENGTH 64
 #define ESP01_PWD_LENGTH 64
 #define ESP01_CMD_LENGTH 256
 #define ESP01_RSP_LENGTH 4096
+#define ESP01_RSP_CHUNK_LENGTH 256
 #define ESP01_DEFAULT_TIMEOUT 1000
 #define ESP01_EXTENDED_TIMEOUT 10000
 #define ESP01_EXTRA_EXTENDED_TIMEOUT 20000
+#define ESP01_SEND_LENGTH 2048
+#define ESP01_MAX_LINKS 5
+#define ESP01_SERVER_MAX_CONNECTIONS ESP01_MAX_LINKS
+#define ESP01_SERVER_BUFFER_LENGTH 1024
+#define ESP01_SERVER_EVENT_QUEUE_LENGTH 4
+#define ESP01_DNS_SERVERS 3
+#define ESP01_DNS_CACHE_SIZE 4
+#define ESP01_DNS_DEFAULT_TTL 300000
+#define ESP01_DNS_DEFAULT_NEGATIVE_TTL 10000
+#define ESP01_PROBE_MAX_HOSTS 4
+#define ESP01_PROBE_RING_LENGTH 64
+#define ESP01_SCHED_QUEUE_LENGTH 8
+#define ESP01_SCHED_DEFAULT_TIMEOUT ESP01_EXTRA_EXTENDED_TIMEOUT
+#define ESP01_LATENCY_CLASSES 16
+#define ESP01_ADAPTIVE_MIN_SAMPLES 4
+#define ESP01_ADAPTIVE_MIN_TIMEOUT 500
+#define ESP01_ADAPTIVE_MAX_TIMEOUT ESP01_EXTRA_EXTENDED_TIMEOUT
+#define ESP01_RECOVERY_RETRIES 2
+#define ESP01_RECOVERY_BACKOFF 50
+#define ESP01_RESYNC_QUIET_TIME 10
+#define ESP01_FLOW_LOW_WATERMARK 4096
+#define ESP01_FLOW_HIGH_WATERMARK 8192
+#define ESP01_FLOW_SAMPLE_INTERVAL 500
+#define ESP01_FLOW_POLL_INTERVAL 20
+#define ESP01_FLOW_THROTTLE_TIMEOUT 500
+#define ESP01_FLOW_COALESCE_DELAY 20
+#define ESP01_TELEMETRY_MTU 1472
+#define ESP01_TELEMETRY_DEFAULT_DEADLINE 100
 
+#define ESP01_DEFAULT_AP_PROPERTIES {"", "", 1, ESP01_AP_ENCRYPTION_WPA2_PSK, ESP01_UNDEFINED, ESP01_UNDEFINED}
+#define ESP01_DEFAULT_SOCKET_OPTIONS {-1, 0, 0, 0, 0}
 #define ESP01_DEFAULT_CONNECTION_PROPERTIES {"", "", "", ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED, ESP01_UNDEFINED}
 
 #define AT_QUERY '?'
@@ -44,7 +101,7 @@
 #define AT_LOCAL_TIMESTAMP "AT+SYSTIMESTAMP"    // [ ] Query/Set Local Time Stamp
 #define AT_SLEEP_CFG "AT+SLEEP"                 // [X] Set the sleep mode.
 #define AT_FACTORY_RESET "AT+RESTORE"           // [X] Restore factory default settings of the module.
-#define AT_RAM "AT+SYSRAM"                      // [ ] Query Current Remaining Heap Size and Minimum Heap Size.
+#define AT_RAM "AT+SYSRAM"                      // [X] Query Current Remaining Heap Size and Minimum Heap Size.
 #define AT_FLASH "AT+SYSFLASH"                  // [ ] Query/Set User Partitions in Flash.
 #define AT_RF_POWER "AT+RFPOWER"                // [ ] Query/Set RF TX Power.
 #define AT_PROMPT "AT+SYSMSG"                   // [ ] Configure system prompt information.
@@ -61,8 +118,8 @@
 #define AT_WIFI_LIST_NETWORKS "AT+CWLAP"            // [ ] List available APs.
 #define AT_WIFI_LIST_NETWORKS_CFG "AT+CWLAPOPT"     // [ ] Set the configuration for the command AT+CWLAP.
 #define AT_WIFI_STATION_DISCONNECT "AT+CWQAP"       // [ ] Disconnect from an AP.
-#define AT_WIFI_AP_CFG "AT+CWSAP"                   // [ ] Query/Set the configuration of an ESP SoftAP.
-#define AT_WIFI_AP_LIST_STATIONS "AT+CWLIF"         // [ ] Obtain IP address of the station that connects to an ESP SoftAP.
+#define AT_WIFI_AP_CFG "AT+CWSAP"                   // [X] Query/Set the configuration of an ESP SoftAP.
+#define AT_WIFI_AP_LIST_STATIONS "AT+CWLIF"         // [X] Obtain IP address of the station that connects to an ESP SoftAP.
 #define AT_WIFI_AP_KICK_STATION "AT+CWQIF"          // [ ] Disconnect stations from an ESP SoftAP.
 #define AT_WIFI_DHCP "AT+CWDHCP"                    // [ ] Enable/disable DHCP.
 #define AT_WIFI_DHCP_LEASES "AT+CWDHCPS"            // [ ] Query/Set the IP addresses allocated by an ESP SoftAP DHCP server.
@@ -83,17 +140,18 @@
 // IP
 #define AT_IP_V6 "AT+CIPV6"                                 // [ ] Enable/disable the network of Internet Protocol Version 6 (IPv6).
 #define AT_IP_STATUS "AT+CIPSTATUS"                         // [ ] Obtain the TCP/UDP/SSL connection status and information.
-#define AT_IP_DOMAIN "AT+CIPDOMAIN"                         // [ ] Resolve a Domain Name.
-#define AT_IP_START "AT+CIPSTART"                           // [ ] Establish TCP connection, UDP transmission, or SSL connection.
-#define AT_IP_SEND "AT+CIPSEND"                             // [ ] Send data in the normal transmission mode or Wi-Fi passthrough mode.
-#define AT_IP_CLOSE "AT+CIPCLOSE"                           // [ ] Close TCP/UDP/SSL connection.
+#define AT_IP_DOMAIN "AT+CIPDOMAIN"                         // [X] Resolve a Domain Name.
+#define AT_IP_START "AT+CIPSTART"                           // [X] Establish TCP connection, UDP transmission, or SSL connection.
+#define AT_IP_SEND "AT+CIPSEND"                             // [X] Send data in the normal transmission mode or Wi-Fi passthrough mode.
+#define AT_IP_SEND_EX "AT+CIPSENDEX"                        // [X] Send data in the normal transmission mode in expanded ways.
+#define AT_IP_CLOSE "AT+CIPCLOSE"                           // [X] Close TCP/UDP/SSL connection.
 #define AT_IP_LOCAL_ADDRESS "AT+CIFSR"                      // [ ] Obtain the local IP address and MAC address.
-#define AT_IP_MUX_MODE "AT+CIPMUX"                          // [ ] Enable/disable the multiple connections mode.
-#define AT_IP_SERVER "AT+CIPSERVER"                         // [ ] Delete/create a TCP/SSL server.
-#define AT_IP_SERVER_MAX_CONNECTIONS "AT+CIPSERVERMAXCONN"  // [ ] Query/Set the maximum connections allowed by a server.
+#define AT_IP_MUX_MODE "AT+CIPMUX"                          // [X] Enable/disable the multiple connections mode.
+#define AT_IP_SERVER "AT+CIPSERVER"                         // [X] Delete/create a TCP/SSL server.
+#define AT_IP_SERVER_MAX_CONNECTIONS "AT+CIPSERVERMAXCONN"  // [X] Query/Set the maximum connections allowed by a server.
 #define AT_IP_TX_MODE "AT+CIPMODE"                          // [ ] Query/Set the transmission mode.
 #define AT_IP_AUTO_PASSTHROUGH "AT+SAVETRANSLINK"           // [ ] Set whether to enter Wi-Fi passthrough mode on power-up.
-#define AT_IP_SERVER_TIMEOUT "AT+CIPSTO"                    // [ ] Query/Set the local TCP Server Timeout.
+#define AT_IP_SERVER_TIMEOUT "AT+CIPSTO"                    // [X] Query/Set the local TCP Server Timeout.
 #define AT_IP_SNTP_CFG "AT+CIPSNTPCFG"                      // [ ] Query/Set the time zone and SNTP server.
 #define AT_IP_SNTP "AT+CIPSNTPTIME"                         // [ ] Query the SNTP time.
 #define AT_IP_SSL_LIST_CLIENTS "AT+CIPSSLCCONF"             // [ ] Query/Set SSL clients.
@@ -105,9 +163,9 @@
 #define AT_IP_SOCKET_MODE "AT+CIPRECVMODE"                  // [ ] Query/Set socket receiving mode.
 #define AT_IP_SOCKET_DATA "AT+CIPRECVDATA"                  // [ ] Obtain socket data in passive receiving mode.
 #define AT_IP_SOCKET_DATA_LENGTH "AT+CIPRECVLEN"            // [ ] Obtain socket data length in passive receiving mode.
-#define AT_IP_SOCKET_CFG "AT+CIPTCPOPT"                     // [ ] Query/Set the socket options.
-#define AT_IP_PING "AT+PING"                                // [ ] Ping the remote host.
-#define AT_IP_DNS "AT+CIPDNS"                               // [ ] Query/Set DNS server information.
+#define AT_IP_SOCKET_CFG "AT+CIPTCPOPT"                     // [X] Query/Set the socket options.
+#define AT_IP_PING "AT+PING"                                // [X] Ping the remote host.
+#define AT_IP_DNS "AT+CIPDNS"                               // [X] Query/Set DNS server information.
 
 // MQTT
 #define AT_MQTT_USER_CFG "AT+MQTTUSERCFG"               // [ ] Set MQTT User Configuration.
@@ -135,14 +193,284 @@ struct esp01_uart_settings {
     bool rts;
 } typedef esp01_uart_settings_t;
 
+struct esp01_inst;
+
+// Unsolicited result code
+enum esp01_urc {
+    ESP01_URC_CONNECT = 0,
+    ESP01_URC_CLOSED = 1,
+    ESP01_URC_DATA = 2,
+} typedef esp01_urc_t;
+
+/*!
+ * Unsolicited result code handler, called from the receive loop (it must not send commands).
+ * Socket data (+IPD) is handed in chunks of at most ESP01_RSP_CHUNK_LENGTH bytes.
+ *
+ * @param inst Pointer to the communication instance
+ * @param urc Unsolicited result code
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param data Socket data (NULL for connection events)
+ * @param len Socket data length
+ * @param ctx User context
+ */
+typedef void (*esp01_urc_handler_t)(struct esp01_inst *inst, esp01_urc_t urc, int link_id, const char *data,
+                                    size_t len, void *ctx);
+
+// DNS cache entry
+struct esp01_dns_entry {
+    bool valid;
+    bool negative;
+    char host[ESP01_HOST_LENGTH + 1];
+    char ip[ESP01_IP_LENGTH + 1];
+    uint32_t expires_ms;
+    uint32_t last_used_ms;
+} typedef esp01_dns_entry_t;
+
+// DNS cache statistics
+struct esp01_dns_stats {
+    uint hits;
+    uint negative_hits;
+    uint misses;
+    uint evictions;
+} typedef esp01_dns_stats_t;
+
+// DNS cache
+struct esp01_dns_cache {
+    esp01_dns_entry_t entries[ESP01_DNS_CACHE_SIZE];
+    uint ttl_ms;
+    uint negative_ttl_ms;
+    esp01_dns_stats_t stats;
+} typedef esp01_dns_cache_t;
+
+#define ESP01_SOCKET_LINGER 0x1
+#define ESP01_SOCKET_NODELAY 0x2
+#define ESP01_SOCKET_SNDTIMEO 0x4
+#define ESP01_SOCKET_KEEPALIVE 0x8
+#define ESP01_SOCKET_ALL 0xf
+
+// TCP socket options (the options missing from set keep the device value)
+struct esp01_socket_options {
+    int so_linger;      // Linger time in s (-1: disabled, the firmware default)
+    int tcp_nodelay;    // 1 to disable Nagle's algorithm
+    int so_sndtimeo;    // Send timeout in ms
+    int keep_alive;     // Keepalive interval in s (0: disabled)
+    uint set;           // ESP01_SOCKET_* flags of the options to apply
+} typedef esp01_socket_options_t;
+
+// Trace record type
+enum esp01_trace_type {
+    ESP01_TRACE_EVENT = 0,
+    ESP01_TRACE_TX = 1,
+    ESP01_TRACE_RX = 2,
+} typedef esp01_trace_type_t;
+
+// Trace event (payload of ESP01_TRACE_EVENT records)
+enum esp01_trace_event {
+    ESP01_TRACE_TIMEOUT = 0,
+    ESP01_TRACE_UNWRITABLE = 1,
+    ESP01_TRACE_OVERFLOW = 2,
+    ESP01_TRACE_PROMPT = 3,
+    ESP01_TRACE_BUSY = 4,
+    ESP01_TRACE_FRAMING = 5,
+    ESP01_TRACE_RESYNC = 6,
+    ESP01_TRACE_RETRY = 7,
+    ESP01_TRACE_MALFORMED = 8,
+} typedef esp01_trace_event_t;
+
+/*!
+ * Trace ring, storing records made of a header (timestamp in us on 4 bytes little endian, type on 1 byte, payload
+ * length on 1 byte) followed by the payload. Data longer than ESP01_TRACE_PAYLOAD_LENGTH is split in several records.
+ * The oldest records are overwritten when the ring is full.
+ */
+struct esp01_trace {
+    uint8_t ring[ESP01_TRACE_RING_LENGTH];
+    uint head;
+    uint tail;
+    uint used;
+    uint dropped;
+} typedef esp01_trace_t;
+
+// Command priority
+enum esp01_priority {
+    ESP01_PRIORITY_LOW = 0,
+    ESP01_PRIORITY_NORMAL = 1,
+    ESP01_PRIORITY_HIGH = 2,
+} typedef esp01_priority_t;
+
+#define ESP01_PRIORITIES 3
+
+// Caller waiting for the instance
+struct esp01_sched_ticket {
+    bool used;
+    esp01_priority_t priority;
+    uint32_t seq;
+} typedef esp01_sched_ticket_t;
+
+// Scheduler statistics (wait times in us, per priority)
+struct esp01_sched_stats {
+    uint acquired[ESP01_PRIORITIES];
+    uint64_t total_wait_us[ESP01_PRIORITIES];
+    uint32_t max_wait_us[ESP01_PRIORITIES];
+    uint timeouts;              // Waits that timed out (not the tries without a timeout)
+    uint rejected;
+} typedef esp01_sched_stats_t;
+
+// Scheduler (recursive lock granted by priority, then in arrival order)
+struct esp01_sched {
+    lock_core_t core;
+    lock_owner_id_t owner;
+    bool owner_irq;
+    uint depth;
+    esp01_sched_ticket_t queue[ESP01_SCHED_QUEUE_LENGTH];
+    uint32_t next_seq;
+    uint timeout_ms;
+    esp01_sched_stats_t stats;
+} typedef esp01_sched_t;
+
+// Latency estimate of a command class (label and mode), the latency being the longest silence of the device
+struct esp01_latency_class {
+    uint32_t key;
+    uint32_t last_used;
+    uint samples;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint backoff;
+} typedef esp01_latency_class_t;
+
+// Adaptive timeouts
+struct esp01_latency {
+    bool adaptive;
+    uint min_ms;
+    uint max_ms;
+    uint32_t clock;
+    esp01_latency_class_t classes[ESP01_LATENCY_CLASSES];
+} typedef esp01_latency_t;
+
+// Latency estimate
+struct esp01_latency_estimate {
+    uint samples;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint timeout_ms;
+} typedef esp01_latency_estimate_t;
+
+// Response status
+enum esp01_rsp_status {
+    ESP01_RSP_OK = 0,
+    ESP01_RSP_ERROR = 1,
+    ESP01_RSP_TIMEOUT = 2,
+    ESP01_RSP_UNWRITABLE = 3,
+    ESP01_RSP_CMD_OVERFLOW = 4,
+    ESP01_RSP_LOCK_TIMEOUT = 5,
+    ESP01_RSP_BUSY = 6,
+    ESP01_RSP_FRAMING = 7,
+    ESP01_RSP_OVERFLOW = 8,
+} typedef esp01_rsp_status_t;
+
+// Recovery statistics
+struct esp01_recovery_stats {
+    uint timeouts;
+    uint busy;
+    uint framing;
+    uint overflows;
+    uint resyncs;
+    uint resync_failures;
+    uint retries;
+    uint recovered;
+    uint64_t time_lost_us;
+} typedef esp01_recovery_stats_t;
+
+// Recovery after timeouts, busy device and corrupted responses
+struct esp01_recovery {
+    uint max_retries;
+    uint backoff_ms;
+    uint32_t nonce;
+    esp01_recovery_stats_t stats;
+} typedef esp01_recovery_t;
+
+// Streaming send (AT+CIPSENDEX frames ended by \0)
+struct esp01_send_stream {
+    struct esp01_inst *inst;
+    int link_id;
+    bool open;
+    size_t frame_len;       // Bytes written in the current frame (escapes included)
+    size_t len;             // Data bytes written
+    uint frames;
+} typedef esp01_send_stream_t;
+
+// Device heap
+struct esp01_sysram {
+    int free;
+    int min;        // Minimum free heap since boot (ESP01_UNDEFINED if not reported by the firmware)
+} typedef esp01_sysram_t;
+
+// Flow control statistics
+struct esp01_flow_stats {
+    uint samples;
+    uint busy_samples;      // Samples taken because the device answered busy
+    int last_free;          // ESP01_UNDEFINED until the first sample
+    int last_min;
+    int lowest_free;        // Lowest free heap observed by the driver
+    uint throttles;
+    uint throttle_timeouts;
+    uint64_t throttle_us;
+    uint coalesced;         // Sends merged into a pending send
+    uint flushes;
+    size_t dropped;         // Bytes of pending sends that failed
+} typedef esp01_flow_stats_t;
+
+// Heap aware flow control of the sends
+struct esp01_flow {
+    bool enabled;
+    bool coalesce;
+    bool supported;         // Cleared if the firmware doesn't know AT+SYSRAM
+    bool stale;             // Set when the device answers busy
+    uint low_watermark;
+    uint high_watermark;
+    uint interval_ms;
+    uint64_t sampled_us;
+    int free;
+    char *pending;          // Coalesced sends (ESP01_SEND_LENGTH bytes, allocated on first use)
+    size_t pending_len;
+    int pending_link;
+    uint64_t pending_us;
+    esp01_flow_stats_t stats;
+} typedef esp01_flow_t;
+
 // ESP01 instance struct
 struct esp01_inst {
     uart_inst_t *uart_inst;
     uint tx_pin;
     uint rx_pin;
     esp01_uart_settings_t uart_settings;
+    esp01_urc_handler_t urc_handler;
+    void *urc_ctx;
+    esp01_dns_cache_t dns_cache;
+    esp01_socket_options_t socket_options;
+    esp01_sched_t sched;
+    esp01_latency_t latency;
+    esp01_recovery_t recovery;
+    esp01_flow_t flow;
+    esp01_rsp_status_t last_status;
+    uint8_t client_links;       // Links opened by esp01_ip_connect (bit per link ID)
+#if ESP01_TRACE_LEVEL > 0
+    esp01_trace_t trace;
+#endif
 } typedef esp01_inst_t;
 
+/*!
+ * Response sink, receiving the response data lines (with their '\n') in chunks of at most ESP01_RSP_CHUNK_LENGTH
+ * bytes. A line longer than a chunk is split in several chunks. A NULL chunk means that the data received so far
+ * belongs to a previous exchange and must be discarded. The data following a +CIPRECVDATA,<len>: header is binary
+ * (it may hold '\0', '\r' and '\n') and is handed over as is.
+ *
+ * @param chunk Response chunk (not NUL terminated) or NULL
+ * @param len Chunk length
+ * @param ctx User context
+ * @return True to continue receiving data, false to discard the rest of the response
+ */
+typedef bool (*esp01_rsp_sink_t)(const char *chunk, size_t len, void *ctx);
+
 // Version struct
 struct esp01_version {
     char *at;
@@ -219,6 +547,179 @@ struct esp01_connection_properties {
     esp01_pmf_mode_t pmf;
 } typedef esp01_connection_properties_t;
 
+// SoftAP encryption
+enum esp01_ap_encryption {
+    ESP01_AP_ENCRYPTION_OPEN = 0,
+    ESP01_AP_ENCRYPTION_WPA_PSK = 2,
+    ESP01_AP_ENCRYPTION_WPA2_PSK = 3,
+    ESP01_AP_ENCRYPTION_WPA_WPA2_PSK = 4,
+} typedef esp01_ap_encryption_t;
+
+// SoftAP properties struct
+struct esp01_ap_properties {
+    char ssid[ESP01_SSID_LENGTH + 1];
+    char password[ESP01_PWD_LENGTH + 1];
+    int channel;
+    esp01_ap_encryption_t encryption;
+    int max_connections;
+    int ssid_hidden;
+} typedef esp01_ap_properties_t;
+
+// Station connected to the SoftAP
+struct esp01_station {
+    char ip[ESP01_IP_LENGTH + 1];
+    char mac[ESP01_MAC_LENGTH + 1];
+} typedef esp01_station_t;
+
+// DNS properties struct
+struct esp01_dns_properties {
+    bool manual;
+    char servers[ESP01_DNS_SERVERS][ESP01_IP_LENGTH + 1];
+} typedef esp01_dns_properties_t;
+
+// Connection type
+enum esp01_ip_type {
+    ESP01_IP_TCP = 0,
+    ESP01_IP_UDP = 1,
+    ESP01_IP_SSL = 2,
+} typedef esp01_ip_type_t;
+
+// Network probe sample
+struct esp01_probe_sample {
+    uint32_t timestamp_ms;
+    uint host;
+    bool timeout;
+    uint rtt_ms;
+    int rssi;
+    int channel;
+} typedef esp01_probe_sample_t;
+
+// Network probe statistics (RTT in ms, computed over the successful pings)
+struct esp01_probe_stats {
+    uint count;
+    uint timeouts;
+    uint min_ms;
+    uint avg_ms;
+    uint p95_ms;
+    uint max_ms;
+    uint rssi_count;    // Samples with a known RSSI (avg_rssi and the correlation are computed over them)
+    int avg_rssi;       // ESP01_UNDEFINED if no sample has a RSSI
+    float rtt_rssi_correlation;
+} typedef esp01_probe_stats_t;
+
+// Network probe struct
+struct esp01_probe {
+    esp01_inst_t *inst;
+    char hosts[ESP01_PROBE_MAX_HOSTS][ESP01_HOST_LENGTH + 1];
+    uint host_count;
+    uint interval_ms;
+    uint32_t next_ms;
+    uint next_host;
+    int rssi;
+    int channel;
+    esp01_probe_sample_t samples[ESP01_PROBE_RING_LENGTH];
+    uint head;
+    uint count;
+} typedef esp01_probe_t;
+
+// Server connection event (connect/close) waiting to be dispatched
+struct esp01_server_event {
+    esp01_urc_t urc;
+    size_t offset;      // Length of the buffered data received before the event
+} typedef esp01_server_event_t;
+
+// Server connection (pooled, one per link ID)
+struct esp01_server_conn {
+    int link_id;
+    bool active;
+    esp01_server_event_t events[ESP01_SERVER_EVENT_QUEUE_LENGTH];   // In reception order
+    uint event_count;
+    char buffer[ESP01_SERVER_BUFFER_LENGTH];
+    size_t len;
+    void *user;
+} typedef esp01_server_conn_t;
+
+struct esp01_server;
+
+/*!
+ * Server connection event handler (connect/close).
+ *
+ * @param server Pointer to the server
+ * @param conn Pointer to the connection
+ * @param ctx User context
+ */
+typedef void (*esp01_server_event_handler_t)(struct esp01_server *server, esp01_server_conn_t *conn, void *ctx);
+
+/*!
+ * Server data handler, called with the data buffered for a connection.
+ *
+ * @param server Pointer to the server
+ * @param conn Pointer to the connection
+ * @param data Buffered data
+ * @param len Buffered data length
+ * @param ctx User context
+ * @return Number of bytes consumed (the rest is kept until more data arrives)
+ */
+typedef size_t (*esp01_server_data_handler_t)(struct esp01_server *server, esp01_server_conn_t *conn,
+                                              const char *data, size_t len, void *ctx);
+
+// Server statistics
+struct esp01_server_stats {
+    uint accepted;
+    uint rejected;
+    uint closed;
+    uint missed;        // Connections opened and closed between two polls while the event queue was full
+    uint rx_bytes;
+    uint dropped_bytes;
+} typedef esp01_server_stats_t;
+
+// Server struct
+struct esp01_server {
+    esp01_inst_t *inst;
+    uint port;
+    uint max_connections;
+    esp01_server_conn_t conns[ESP01_SERVER_MAX_CONNECTIONS];
+    esp01_server_event_handler_t on_connect;
+    esp01_server_data_handler_t on_data;
+    esp01_server_event_handler_t on_close;
+    void *ctx;
+    esp01_urc_handler_t next_handler;   // Previous URC handler, gets the events of the links opened by the driver
+    void *next_ctx;
+    esp01_server_stats_t stats;
+} typedef esp01_server_t;
+
+// Telemetry statistics
+struct esp01_telemetry_stats {
+    uint datagrams;
+    uint samples;               // Samples sent
+    uint min_batch;             // Samples per datagram
+    uint max_batch;
+    uint64_t total_latency_us;  // Flush latency (from the first sample of a datagram to its send)
+    uint64_t max_latency_us;
+    uint dropped;               // Samples dropped (both buffers full, sample too long or send failure)
+    uint send_failures;
+} typedef esp01_telemetry_stats_t;
+
+// Telemetry datagram buffer
+struct esp01_telemetry_buffer {
+    char data[ESP01_TELEMETRY_MTU];
+    size_t len;
+    uint samples;
+    uint64_t first_us;
+} typedef esp01_telemetry_buffer_t;
+
+// Telemetry channel (samples are packed in UDP datagrams, one buffer is filled while the other is sent)
+struct esp01_telemetry {
+    esp01_inst_t *inst;
+    int link_id;
+    uint deadline_ms;
+    spin_lock_t *lock;
+    esp01_telemetry_buffer_t buffers[2];
+    uint fill;                  // Buffer being filled
+    bool full;                  // The other buffer waits to be sent
+    esp01_telemetry_stats_t stats;
+} typedef esp01_telemetry_t;
+
 /*!
  * Initialize a communication with ESP01 device.
  *
@@ -261,6 +762,107 @@ esp01_uart_settings_t esp01_get_host_uart(esp01_inst_t *inst);
  */
 void esp01_set_host_uart(esp01_inst_t *inst, esp01_uart_settings_t uart_set);
 
+/*!
+ * Lock the instance for the caller (nested locks by the owner are allowed).
+ * Commands sent without holding the lock lock the instance themselves: sends are ESP01_PRIORITY_HIGH, queries and
+ * diagnostics are ESP01_PRIORITY_LOW, other commands are ESP01_PRIORITY_NORMAL.
+ * @note From an interrupt handler, the lock is only taken if it is free (timeout is ignored).
+ *
+ * @param inst Pointer to the communication instance
+ * @param priority Caller priority (waiting callers are served by priority, then in arrival order)
+ * @param timeout_ms Maximum time to wait for the lock in ms
+ * @return True if the lock was taken, false if it timed out, too many callers are waiting or the priority is invalid
+ */
+bool esp01_lock(esp01_inst_t *inst, esp01_priority_t priority, uint timeout_ms);
+
+/*!
+ * Unlock the instance (only the owner can, once per successful esp01_lock).
+ *
+ * @param inst Pointer to the communication instance
+ */
+void esp01_unlock(esp01_inst_t *inst);
+
+/*!
+ * Set the maximum time commands wait for the lock when the caller doesn't hold it.
+ *
+ * @param inst Pointer to the communication instance
+ * @param timeout_ms Maximum time to wait for the lock in ms. @see ESP01_SCHED_DEFAULT_TIMEOUT
+ */
+void esp01_set_sched_timeout(esp01_inst_t *inst, uint timeout_ms);
+
+/*!
+ * Get scheduler statistics.
+ *
+ * @param inst Pointer to the communication instance
+ * @return Scheduler statistics
+ */
+esp01_sched_stats_t esp01_get_sched_stats(esp01_inst_t *inst);
+
+/*!
+ * Configure adaptive timeouts. Once a command class (label and mode) has ESP01_ADAPTIVE_MIN_SAMPLES samples, its
+ * timeout is derived from its smoothed latency and variance (srtt + 4 * rttvar, as TCP does for RTO) instead of the
+ * timeout given by the caller. The timeout is doubled after each timeout of the class, until the next response.
+ * Commands whose latency depends on the network or on their params (AT+CWJAP=, AT+CIPSTART=, AT+PING=,
+ * AT+CIPDOMAIN=, AT+CIPSEND=...) always use the caller timeouts.
+ *
+ * @param inst Pointer to the communication instance
+ * @param enabled True to enable adaptive timeouts, false to always use the caller timeouts
+ * @param min_ms Minimum timeout in ms. @see ESP01_ADAPTIVE_MIN_TIMEOUT
+ * @param max_ms Maximum timeout in ms. @see ESP01_ADAPTIVE_MAX_TIMEOUT
+ */
+void esp01_set_adaptive_timeouts(esp01_inst_t *inst, bool enabled, uint min_ms, uint max_ms);
+
+/*!
+ * Get the latency estimate of a command class.
+ *
+ * @param inst Pointer to the communication instance
+ * @param cmd_mode Command mode ('?'/'='/'\0')
+ * @param label Command label (AT+...)
+ * @param estimate Pointer to the variable used to store the result
+ * @return True if the command class has samples, false otherwise
+ */
+bool esp01_get_latency_estimate(esp01_inst_t *inst, char cmd_mode, const char *label,
+                                esp01_latency_estimate_t *estimate);
+
+/*!
+ * Configure the recovery of failed commands. A command that timed out or got a corrupted response is retried after
+ * resynchronizing the link, a command refused by a busy device is retried after a backoff (doubled on each retry).
+ * Only the commands known to be idempotent are retried (queries, configuration), never sends, connections, resets or
+ * unknown commands. The link is resynchronized after a final failure as well, so that a late response isn't taken for
+ * the response of the next command.
+ * @note Commands sent from an interrupt handler are never retried.
+ *
+ * @param inst Pointer to the communication instance
+ * @param max_retries Maximum number of retries (0 to disable). @see ESP01_RECOVERY_RETRIES
+ * @param backoff_ms Delay before the first retry in ms. @see ESP01_RECOVERY_BACKOFF
+ */
+void esp01_set_recovery(esp01_inst_t *inst, uint max_retries, uint backoff_ms);
+
+/*!
+ * Resynchronize the link with the device: drain the pending data until the device is quiet, then send a unique probe
+ * command and wait for its echo and termination word.
+ *
+ * @param inst Pointer to the communication instance
+ * @return True if the link is synchronized, false otherwise
+ */
+bool esp01_resync(esp01_inst_t *inst);
+
+/*!
+ * Get the status of the last command (after retries).
+ *
+ * @param inst Pointer to the communication instance
+ * @return Status of the last command
+ */
+esp01_rsp_status_t esp01_get_last_status(esp01_inst_t *inst);
+
+/*!
+ * Get recovery statistics.
+ *
+ * @param inst Pointer to the communication instance
+ * @return Recovery statistics
+ */
+esp01_recovery_stats_t esp01_get_recovery_stats(esp01_inst_t *inst);
+
 /*!
  * Send a command to the ESP01 device.
  *
@@ -271,7 +873,41 @@ void esp01_set_host_uart(esp01_inst_t *inst, esp01_uart_settings_t uart_set);
  * @param ... Command params (last param must end with \r or \n)
  * @return The device respond
  */
-char *esp01_at_cmd(esp01_inst_t *inst, uint timeout_ms, char cmd_mode, char *label, ...);
+char *esp01_at_cmd(esp01_inst_t *inst, uint timeout_ms, char cmd_mode, const char *label, ...);
+
+/*!
+ * Send a command to the ESP01 device and stream the response to a sink (response size is not limited).
+ * @note The termination word (OK/ERROR) is not handed to the sink.
+ *
+ * @param inst Pointer to the communication instance
+ * @param timeout_ms Command timeout in ms
+ * @param sink Response sink
+ * @param ctx User context passed to the sink
+ * @param cmd_mode Command mode ('?'/'='/'\0')
+ * @param label Command label (AT+...)
+ * @param ... Command params (last param must end with \r or \n)
+ * @return The response status
+ */
+esp01_rsp_status_t esp01_at_cmd_stream(esp01_inst_t *inst, uint timeout_ms, esp01_rsp_sink_t sink, void *ctx,
+                                       char cmd_mode, const char *label, ...);
+
+/*!
+ * Set unsolicited result code handler (connection events and socket data).
+ *
+ * @param inst Pointer to the communication instance
+ * @param handler Unsolicited result code handler (NULL to discard them)
+ * @param ctx User context passed to the handler
+ */
+void esp01_set_urc_handler(esp01_inst_t *inst, esp01_urc_handler_t handler, void *ctx);
+
+/*!
+ * Receive unsolicited result codes while no command is running (returns at once if the instance is locked by
+ * another caller, which receives them instead).
+ *
+ * @param inst Pointer to the communication instance
+ * @param timeout_ms Time to wait for data in ms (0 to only process received data)
+ */
+void esp01_poll(esp01_inst_t *inst, uint timeout_ms);
 
 /*!
  * Check if the response is OK.
@@ -289,6 +925,24 @@ bool esp01_rsp_ok(char *rsp);
  */
 bool esp01_rsp_ok_free(char *rsp);
 
+/*!
+ * Read and remove the oldest trace records (whole records only).
+ * @see esp01_trace_t
+ *
+ * @param inst Pointer to the communication instance
+ * @param buf Pointer to the buffer used to store the records
+ * @param max_len Buffer size
+ * @return Number of bytes copied (always 0 if the trace is disabled or if the instance couldn't be locked)
+ */
+uint esp01_trace_read(esp01_inst_t *inst, uint8_t *buf, uint max_len);
+
+/*!
+ * Print and remove the trace records.
+ *
+ * @param inst Pointer to the communication instance
+ */
+void esp01_trace_dump(esp01_inst_t *inst);
+
 /*!
  * Test communication.
  *
@@ -349,6 +1003,15 @@ bool esp01_deep_sleep(esp01_inst_t *inst, uint duration);
  */
 bool esp01_factory_reset(esp01_inst_t *inst);
 
+/*!
+ * Get the free heap of the device.
+ *
+ * @param inst Pointer to the communication instance
+ * @param ram Pointer to the variable used to store the result
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_get_sysram(esp01_inst_t *inst, esp01_sysram_t *ram);
+
 /*!
  * Get current UART settings.
  *
@@ -433,4 +1096,407 @@ bool esp01_get_wifi_connection(esp01_inst_t *inst, esp01_connection_properties_t
  */
 bool esp01_wifi_connect(esp01_inst_t *inst, esp01_connection_properties_t properties, esp01_wifi_error_t *error_code);
 
+/*!
+ * Get SoftAP configuration.
+ *
+ * @param inst Pointer to the communication instance
+ * @param properties Pointer to the variable used to store the result
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_get_ap_config(esp01_inst_t *inst, esp01_ap_properties_t *properties);
+
+/*!
+ * Set SoftAP configuration. The optional fields left undefined (maximum number of stations, hidden SSID) are left to
+ * the firmware, the configured maximum number of stations is kept when only the hidden SSID is set.
+ * @note The wifi mode must be ESP01_WIFI_AP or ESP01_WIFI_AP_AND_STATION.
+ *
+ * @param inst Pointer to the communication instance
+ * @param properties SoftAP properties
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_set_ap_config(esp01_inst_t *inst, esp01_ap_properties_t properties);
+
+/*!
+ * Get stations connected to the SoftAP.
+ *
+ * @param inst Pointer to the communication instance
+ * @param stations Array used to store the result
+ * @param max_stations Array size
+ * @param count Pointer to the variable used to store the number of stations
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_get_ap_stations(esp01_inst_t *inst, esp01_station_t *stations, uint max_stations, uint *count);
+
+/*!
+ * Set multiple connections mode.
+ *
+ * @param inst Pointer to the communication instance
+ * @param multiple True to enable multiple connections, false otherwise
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_set_mux_mode(esp01_inst_t *inst, bool multiple);
+
+/*!
+ * Get DNS server information.
+ *
+ * @param inst Pointer to the communication instance
+ * @param properties Pointer to the variable used to store the result
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_get_dns(esp01_inst_t *inst, esp01_dns_properties_t *properties);
+
+/*!
+ * Set DNS server information (pins the resolvers when manual is true).
+ * @note The DNS cache is flushed.
+ *
+ * @param inst Pointer to the communication instance
+ * @param properties DNS properties (empty servers are skipped)
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_set_dns(esp01_inst_t *inst, esp01_dns_properties_t properties);
+
+/*!
+ * Resolve a domain name (without using the DNS cache).
+ *
+ * @param inst Pointer to the communication instance
+ * @param host Domain name
+ * @param ip Pointer to the buffer used to store the result (at least ESP01_IP_LENGTH + 1 bytes)
+ * @return True if the domain name was resolved, false otherwise
+ */
+bool esp01_resolve(esp01_inst_t *inst, const char *host, char *ip);
+
+/*!
+ * Resolve a domain name using the DNS cache (IP addresses are returned as is). Names the device fails to resolve
+ * (ERROR) are cached for the negative time to live, transport failures (timeout, busy device...) aren't cached.
+ *
+ * @param inst Pointer to the communication instance
+ * @param host Domain name or IP address
+ * @param ip Pointer to the buffer used to store the result (at least ESP01_IP_LENGTH + 1 bytes)
+ * @return True if the domain name was resolved, false otherwise
+ */
+bool esp01_dns_lookup(esp01_inst_t *inst, const char *host, char *ip);
+
+/*!
+ * Set DNS cache time to live.
+ *
+ * @param inst Pointer to the communication instance
+ * @param ttl_ms Time to live of resolved names in ms (0 disables the cache)
+ * @param negative_ttl_ms Time to live of names the device failed to resolve in ms (0 disables negative caching)
+ * @return True if the cache was updated, false if the instance couldn't be locked
+ */
+bool esp01_set_dns_cache_ttl(esp01_inst_t *inst, uint ttl_ms, uint negative_ttl_ms);
+
+/*!
+ * Flush the DNS cache.
+ *
+ * @param inst Pointer to the communication instance
+ * @return True if the cache was flushed, false if the instance couldn't be locked
+ */
+bool esp01_flush_dns_cache(esp01_inst_t *inst);
+
+/*!
+ * Get DNS cache statistics.
+ *
+ * @param inst Pointer to the communication instance
+ * @return DNS cache statistics
+ */
+esp01_dns_stats_t esp01_get_dns_cache_stats(esp01_inst_t *inst);
+
+/*!
+ * Open a connection (the host is resolved using the DNS cache).
+ * @note The default socket options are applied to TCP/SSL connections. @see esp01_set_default_socket_options
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param type Connection type
+ * @param host Remote domain name or IP address
+ * @param port Remote port
+ * @return True if the connection was opened, false otherwise
+ */
+bool esp01_ip_connect(esp01_inst_t *inst, int link_id, esp01_ip_type_t type, const char *host, uint port);
+
+/*!
+ * Get the socket options of a connection (all of them are flagged in options->set).
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param options Pointer to the variable used to store the result
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_get_socket_options(esp01_inst_t *inst, int link_id, esp01_socket_options_t *options);
+
+/*!
+ * Set the socket options of a connection (only the options flagged in options.set are sent).
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param options Socket options
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_set_socket_options(esp01_inst_t *inst, int link_id, esp01_socket_options_t options);
+
+/*!
+ * Set the socket options applied to TCP/SSL connections opened by esp01_ip_connect.
+ *
+ * @param inst Pointer to the communication instance
+ * @param options Socket options (ESP01_DEFAULT_SOCKET_OPTIONS, with no option set, keeps the device values)
+ */
+void esp01_set_default_socket_options(esp01_inst_t *inst, esp01_socket_options_t options);
+
+/*!
+ * Send data on a connection.
+ * @note If coalescing is enabled, the data may be kept pending to be sent along with the next data of the same link (it
+ * is sent by the next esp01_ip_send, esp01_ip_flush, esp01_ip_close or, after ESP01_FLOW_COALESCE_DELAY ms,
+ * esp01_poll). A pending send that fails in esp01_poll is only counted in the flow control statistics.
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param data Data to send
+ * @param len Data length
+ * @return True if the data was successfully sent (or kept pending), false otherwise
+ */
+bool esp01_ip_send(esp01_inst_t *inst, int link_id, const char *data, size_t len);
+
+/*!
+ * Start a streaming send, for data whose length isn't known in advance. The data is written to the device as it comes,
+ * in frames of at most ESP01_SEND_LENGTH bytes (the device sends a frame when it gets the \0 terminator).
+ * @note The instance is locked until esp01_ip_send_end, or until a write fails.
+ *
+ * @param inst Pointer to the communication instance
+ * @param stream Pointer to the stream
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @return True if the device is ready to receive the data, false otherwise
+ */
+bool esp01_ip_send_begin(esp01_inst_t *inst, esp01_send_stream_t *stream, int link_id);
+
+/*!
+ * Write data to a streaming send (backslashes are escaped, so the data is sent as is).
+ *
+ * @param stream Pointer to the stream
+ * @param data Data to send
+ * @param len Data length
+ * @return True if the data was successfully written, false otherwise (the stream is closed)
+ */
+bool esp01_ip_send_write(esp01_send_stream_t *stream, const char *data, size_t len);
+
+/*!
+ * End a streaming send and wait for the device to send the last frame.
+ *
+ * @param stream Pointer to the stream
+ * @return True if the data was successfully sent, false otherwise
+ */
+bool esp01_ip_send_end(esp01_send_stream_t *stream);
+
+/*!
+ * Send the data kept pending by the flow control.
+ *
+ * @param inst Pointer to the communication instance
+ * @return True if there is no pending data left, false otherwise (the pending data is dropped)
+ */
+bool esp01_ip_flush(esp01_inst_t *inst);
+
+/*!
+ * Configure the heap aware flow control of the sends. The device free heap is sampled every interval_ms and whenever
+ * the device answers busy. Below the low watermark, sends wait for the heap to recover (up to
+ * ESP01_FLOW_THROTTLE_TIMEOUT ms, the instance stays locked meanwhile).
+ * If coalescing is enabled, small sends are coalesced below the high watermark to save the device buffers.
+ * @note Flow control is disabled if the firmware doesn't support AT+SYSRAM. Coalescing is disabled by default, as
+ * esp01_ip_send then reports success for data that is still pending.
+ *
+ * @param inst Pointer to the communication instance
+ * @param enabled True to enable flow control, false to send the data as is
+ * @param coalesce True to coalesce the small sends, false to send each one when called
+ * @param low_watermark Free heap under which sends wait in bytes. @see ESP01_FLOW_LOW_WATERMARK
+ * @param high_watermark Free heap under which sends are coalesced in bytes. @see ESP01_FLOW_HIGH_WATERMARK
+ * @param interval_ms Heap sampling interval in ms. @see ESP01_FLOW_SAMPLE_INTERVAL
+ */
+void esp01_set_flow_control(esp01_inst_t *inst, bool enabled, bool coalesce, uint low_watermark,
+                            uint high_watermark, uint interval_ms);
+
+/*!
+ * Get flow control statistics, including the heap headroom observed.
+ *
+ * @param inst Pointer to the communication instance
+ * @return Flow control statistics
+ */
+esp01_flow_stats_t esp01_get_flow_stats(esp01_inst_t *inst);
+
+/*!
+ * Close a connection.
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_ip_close(esp01_inst_t *inst, int link_id);
+
+/*!
+ * Ping a remote host.
+ *
+ * @param inst Pointer to the communication instance
+ * @param host Remote domain name or IP address
+ * @param rtt_ms Pointer to the variable used to store the round trip time in ms
+ * @return True if the host answered, false otherwise
+ */
+bool esp01_ping(esp01_inst_t *inst, const char *host, uint *rtt_ms);
+
+/*!
+ * Create a network probe, pinging its hosts in turn and sampling the RSSI once per round.
+ *
+ * @param inst Pointer to the communication instance
+ * @param interval_ms Interval between two pings in ms
+ * @return Pointer to the probe
+ */
+esp01_probe_t *esp01_probe_init(esp01_inst_t *inst, uint interval_ms);
+
+/*!
+ * Delete a network probe.
+ *
+ * @param probe Pointer to the probe
+ */
+void esp01_probe_deinit(esp01_probe_t *probe);
+
+/*!
+ * Add a host to the probe.
+ *
+ * @param probe Pointer to the probe
+ * @param host Remote domain name or IP address
+ * @return Host index, ESP01_UNDEFINED if the probe is full
+ */
+int esp01_probe_add_host(esp01_probe_t *probe, const char *host);
+
+/*!
+ * Run the next scheduled ping if it is due (at most one ping and one RSSI query per call).
+ *
+ * @param probe Pointer to the probe
+ * @return True if a ping was run, false otherwise
+ */
+bool esp01_probe_poll(esp01_probe_t *probe);
+
+/*!
+ * Get the statistics of a host over the samples kept by the probe.
+ *
+ * @param probe Pointer to the probe
+ * @param host Host index
+ * @param channel Only use the samples taken on this channel (ESP01_UNDEFINED for all channels)
+ * @param stats Pointer to the variable used to store the result
+ * @return True if there is at least one sample, false otherwise
+ */
+bool esp01_probe_get_stats(esp01_probe_t *probe, uint host, int channel, esp01_probe_stats_t *stats);
+
+/*!
+ * Get the samples kept by the probe (oldest first).
+ *
+ * @param probe Pointer to the probe
+ * @param samples Array used to store the result
+ * @param max_samples Array size
+ * @return Number of samples copied
+ */
+uint esp01_probe_get_samples(esp01_probe_t *probe, esp01_probe_sample_t *samples, uint max_samples);
+
+/*!
+ * Start a TCP server (enables multiple connections mode). The events of the links opened by esp01_ip_connect aren't
+ * server connections, they are passed on to the URC handler set before the server.
+ *
+ * @param inst Pointer to the communication instance
+ * @param port Server port
+ * @param max_connections Maximum number of connections (at most ESP01_SERVER_MAX_CONNECTIONS)
+ * @param timeout_s Client inactivity timeout in seconds (0 to never close inactive clients)
+ * @return Pointer to the server, NULL if it couldn't be started
+ */
+esp01_server_t *esp01_server_init(esp01_inst_t *inst, uint port, uint max_connections, uint timeout_s);
+
+/*!
+ * Stop a TCP server and close its connections.
+ *
+ * @param server Pointer to the server
+ */
+void esp01_server_deinit(esp01_server_t *server);
+
+/*!
+ * Set server handlers.
+ *
+ * @param server Pointer to the server
+ * @param on_connect Connection handler (can be NULL)
+ * @param on_data Data handler (can be NULL)
+ * @param on_close Close handler (can be NULL)
+ * @param ctx User context passed to the handlers
+ */
+void esp01_server_set_handlers(esp01_server_t *server, esp01_server_event_handler_t on_connect,
+                               esp01_server_data_handler_t on_data, esp01_server_event_handler_t on_close, void *ctx);
+
+/*!
+ * Receive server events and dispatch them to the handlers.
+ * The events of a link are dispatched in reception order: a connection opened and closed since the last poll still
+ * gets on_connect, its data, then on_close (the data left unconsumed at the close is dropped).
+ * @note Handlers are called from this function with the instance locked, so they can send data and commands.
+ *
+ * @param server Pointer to the server
+ * @param timeout_ms Time to wait for data in ms (0 to only process received data)
+ */
+void esp01_server_poll(esp01_server_t *server, uint timeout_ms);
+
+/*!
+ * Close a server connection.
+ *
+ * @param server Pointer to the server
+ * @param conn Pointer to the connection
+ * @return True if the command was successfully executed, false otherwise
+ */
+bool esp01_server_close(esp01_server_t *server, esp01_server_conn_t *conn);
+
+/*!
+ * Open a UDP telemetry channel to a fixed peer.
+ *
+ * @param inst Pointer to the communication instance
+ * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+ * @param host Remote host
+ * @param port Remote port
+ * @param deadline_ms Maximum time a sample waits before its datagram is sent in ms.
+ * @see ESP01_TELEMETRY_DEFAULT_DEADLINE
+ * @return Pointer to the telemetry channel, NULL if the connection couldn't be opened
+ */
+esp01_telemetry_t *esp01_telemetry_init(esp01_inst_t *inst, int link_id, const char *host, uint port,
+                                        uint deadline_ms);
+
+/*!
+ * Send the pending samples and close a telemetry channel.
+ *
+ * @param telemetry Pointer to the telemetry channel
+ */
+void esp01_telemetry_deinit(esp01_telemetry_t *telemetry);
+
+/*!
+ * Add a sample to the datagram being filled. It never waits for the device, a sample is dropped if both datagram
+ * buffers are full. Samples are concatenated as is, so they must be delimited by the caller (fixed size, separator...).
+ * @note Can be called from an interrupt handler or the other core.
+ *
+ * @param telemetry Pointer to the telemetry channel
+ * @param sample Sample data
+ * @param len Sample length (at most ESP01_TELEMETRY_MTU)
+ * @return True if the sample was added, false if it was dropped
+ */
+bool esp01_telemetry_push(esp01_telemetry_t *telemetry, const void *sample, size_t len);
+
+/*!
+ * Send the full datagram and the datagram being filled if its deadline is reached. Must be called periodically.
+ *
+ * @param telemetry Pointer to the telemetry channel
+ * @param force True to send the datagram being filled regardless of its deadline
+ * @return True if a datagram was sent, false otherwise
+ */
+bool esp01_telemetry_poll(esp01_telemetry_t *telemetry, bool force);
+
+/*!
+ * Get telemetry statistics.
+ *
+ * @param telemetry Pointer to the telemetry channel
+ * @return Telemetry statistics
+ */
+esp01_telemetry_stats_t esp01_telemetry_get_stats(esp01_telemetry_t *telemetry);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
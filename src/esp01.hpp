@@ -0,0 +1,565 @@
+#ifndef _PICO_ESP01_HPP
+#define _PICO_ESP01_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "esp01.h"
+
+#ifndef ESP01_SOCKET_BUFFER_LENGTH
+#define ESP01_SOCKET_BUFFER_LENGTH ESP01_SERVER_BUFFER_LENGTH
+#endif
+
+namespace esp01 {
+
+    // Command string (label and mode) built at compile time
+    template<std::size_t N>
+    struct Command {
+        std::array<char, N> text;
+
+        constexpr const char *c_str() const {
+            return text.data();
+        }
+
+        constexpr std::size_t size() const {
+            return N - 1;
+        }
+    };
+
+    /*!
+     * Build a command string at compile time.
+     * Ex: constexpr auto cmd = esp01::command<AT_QUERY>(AT_WIFI_MODE); // "AT+CWMODE?"
+     *
+     * @tparam Mode Command mode ('?'/'='/'\0')
+     * @param label Command label (AT+...)
+     * @return The command string
+     */
+    template<char Mode, std::size_t N>
+    constexpr Command<N + (Mode != AT_EXECUTE ? 1 : 0)> command(const char (&label)[N]) {
+        Command<N + (Mode != AT_EXECUTE ? 1 : 0)> cmd{};
+        for (std::size_t i = 0; i < N - 1; i++) {
+            cmd.text[i] = label[i];
+        }
+        if constexpr (Mode != AT_EXECUTE) {
+            cmd.text[N - 1] = Mode;
+        }
+        return cmd;
+    }
+
+    // Device response (owns the buffer returned by esp01_at_cmd)
+    class Response {
+    public:
+        Response() = default;
+
+        explicit Response(char *rsp) : rsp_(rsp) {}
+
+        Response(const Response &) = delete;
+
+        Response &operator=(const Response &) = delete;
+
+        Response(Response &&other) noexcept: rsp_(std::exchange(other.rsp_, nullptr)) {}
+
+        Response &operator=(Response &&other) noexcept {
+            if (this != &other) {
+                std::free(rsp_);
+                rsp_ = std::exchange(other.rsp_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Response() {
+            std::free(rsp_);
+        }
+
+        /*!
+         * Check if the device answered OK.
+         *
+         * @return True if the response ends with OK, false otherwise
+         */
+        bool ok() const {
+            return esp01_rsp_ok(rsp_);
+        }
+
+        explicit operator bool() const {
+            return ok();
+        }
+
+        /*!
+         * Get the response text (with its termination word).
+         *
+         * @return The response text, empty if there is no response
+         */
+        std::string_view text() const {
+            return rsp_ != nullptr ? std::string_view(rsp_) : std::string_view();
+        }
+
+        /*!
+         * Release the ownership of the response buffer.
+         *
+         * @return The response buffer (to be freed by the caller)
+         */
+        char *release() {
+            return std::exchange(rsp_, nullptr);
+        }
+
+    private:
+        char *rsp_ = nullptr;
+    };
+
+    // Device version (owns the strings of esp01_version_t)
+    class Version {
+    public:
+        Version() = default;
+
+        explicit Version(esp01_version_t ver) : ver_(ver) {}
+
+        Version(const Version &) = delete;
+
+        Version &operator=(const Version &) = delete;
+
+        Version(Version &&other) noexcept: ver_(std::exchange(other.ver_, {})) {}
+
+        Version &operator=(Version &&other) noexcept {
+            if (this != &other) {
+                reset();
+                ver_ = std::exchange(other.ver_, {});
+            }
+            return *this;
+        }
+
+        ~Version() {
+            reset();
+        }
+
+        explicit operator bool() const {
+            return ver_.at != nullptr;
+        }
+
+        std::string_view at() const {
+            return view(ver_.at);
+        }
+
+        std::string_view sdk() const {
+            return view(ver_.sdk);
+        }
+
+        std::string_view bin() const {
+            return view(ver_.bin);
+        }
+
+    private:
+        esp01_version_t ver_ = {};
+
+        static std::string_view view(const char *str) {
+            return str != nullptr ? std::string_view(str) : std::string_view();
+        }
+
+        void reset() {
+            std::free(ver_.at);
+            std::free(ver_.sdk);
+            std::free(ver_.bin);
+            ver_ = {};
+        }
+    };
+
+    // Character arrays are C strings, sent without their terminator
+    template<typename T>
+    constexpr bool is_char_array_v = std::is_array_v<T> &&
+                                     std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>;
+
+    // Receive buffer of a link, filled by the URC handler of the instance (only touched under the instance lock)
+    struct SocketBuffer {
+        std::unique_ptr<char[]> data;   // ESP01_SOCKET_BUFFER_LENGTH bytes, allocated when the link is first opened
+        std::size_t len = 0;
+        std::size_t dropped = 0;        // Bytes received while the buffer was full
+        bool open = false;
+        bool closed = false;            // The device reported the link as closed
+
+        void reset(bool opened) {
+            if (opened && data == nullptr) {
+                data = std::make_unique<char[]>(ESP01_SOCKET_BUFFER_LENGTH);
+            }
+            len = 0;
+            dropped = 0;
+            open = opened;
+            closed = false;
+        }
+
+        void push(const char *chunk, std::size_t chunk_len) {
+            std::size_t room = ESP01_SOCKET_BUFFER_LENGTH - len;
+            if (chunk_len > room) {
+                dropped += chunk_len - room;
+                chunk_len = room;
+            }
+            std::memcpy(data.get() + len, chunk, chunk_len);
+            len += chunk_len;
+        }
+    };
+
+    // Connection (closed when the handle is destroyed)
+    class Socket {
+    public:
+        Socket() = default;
+
+        /*!
+         * Wrap a connection opened with the C API (it can send, but only sockets opened by Esp01::connect receive).
+         *
+         * @param inst Pointer to the communication instance
+         * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+         * @param buffer Receive buffer of the link
+         */
+        Socket(esp01_inst_t *inst, int link_id, SocketBuffer *buffer = nullptr)
+                : inst_(inst), link_id_(link_id), buffer_(buffer) {}
+
+        Socket(const Socket &) = delete;
+
+        Socket &operator=(const Socket &) = delete;
+
+        Socket(Socket &&other) noexcept: inst_(std::exchange(other.inst_, nullptr)), link_id_(other.link_id_),
+                                         buffer_(std::exchange(other.buffer_, nullptr)) {}
+
+        Socket &operator=(Socket &&other) noexcept {
+            if (this != &other) {
+                close();
+                inst_ = std::exchange(other.inst_, nullptr);
+                link_id_ = other.link_id_;
+                buffer_ = std::exchange(other.buffer_, nullptr);
+            }
+            return *this;
+        }
+
+        ~Socket() {
+            close();
+        }
+
+        explicit operator bool() const {
+            return inst_ != nullptr;
+        }
+
+        int link_id() const {
+            return link_id_;
+        }
+
+        // True once the device reported the connection as closed
+        bool peer_closed() const {
+            return buffer_ != nullptr && buffer_->closed;
+        }
+
+        // Bytes dropped because the receive buffer was full
+        std::size_t dropped() const {
+            return buffer_ != nullptr ? buffer_->dropped : 0;
+        }
+
+        /*!
+         * Send data on the connection.
+         *
+         * @param data Data to send
+         * @return True if the data was successfully sent, false otherwise
+         */
+        bool send(std::string_view data) const {
+            return inst_ != nullptr && esp01_ip_send(inst_, link_id_, data.data(), data.size());
+        }
+
+        /*!
+         * Send a C string (without its terminator).
+         *
+         * @param str String to send
+         * @return True if the data was successfully sent, false otherwise
+         */
+        bool send(const char *str) const {
+            return send(std::string_view(str));
+        }
+
+        /*!
+         * Send the bytes of a contiguous container (std::array, std::vector, C array...). Character arrays are sent
+         * as C strings.
+         *
+         * @param data Data to send
+         * @return True if the data was successfully sent, false otherwise
+         */
+        template<typename Container>
+        auto send(const Container &data) const
+        -> std::enable_if_t<!is_char_array_v<Container>, decltype(std::data(data), std::size(data), bool())> {
+            return send(std::string_view(reinterpret_cast<const char *>(std::data(data)),
+                                         std::size(data) * sizeof(*std::data(data))));
+        }
+
+        /*!
+         * Receive the data of the connection. The data is buffered by the instance as soon as it arrives (while
+         * another command runs too), the device is only polled if nothing is buffered. The handler is called as
+         * void(std::string_view data) with all the buffered data, while the instance is locked.
+         *
+         * @param handler Data handler
+         * @param timeout_ms Time to wait for data in ms (0 to only process received data)
+         * @return Number of bytes received
+         */
+        template<typename Handler>
+        std::size_t receive(Handler &&handler, uint timeout_ms) {
+            if (inst_ == nullptr || buffer_ == nullptr) {
+                return 0;
+            }
+
+            // The buffer is filled by the receive loop, which only runs for the owner of the lock
+            if (!esp01_lock(inst_, ESP01_PRIORITY_NORMAL, inst_->sched.timeout_ms)) {
+                return 0;
+            }
+
+            if (buffer_->len == 0 && !buffer_->closed) {
+                esp01_poll(inst_, timeout_ms);
+            }
+
+            // Data received while the handler runs (if it sends commands) is kept after these bytes
+            std::size_t len = buffer_->len;
+            if (len > 0) {
+                handler(std::string_view(buffer_->data.get(), len));
+                std::memmove(buffer_->data.get(), buffer_->data.get() + len, buffer_->len - len);
+                buffer_->len -= len;
+            }
+
+            esp01_unlock(inst_);
+            return len;
+        }
+
+        /*!
+         * Close the connection (a connection closed by the peer is only released).
+         *
+         * @return True if the command was successfully executed, false otherwise
+         */
+        bool close() {
+            if (inst_ == nullptr) {
+                return false;
+            }
+            esp01_inst_t *inst = std::exchange(inst_, nullptr);
+            SocketBuffer *buffer = std::exchange(buffer_, nullptr);
+            if (buffer == nullptr) {
+                return esp01_ip_close(inst, link_id_);
+            }
+
+            if (!esp01_lock(inst, ESP01_PRIORITY_HIGH, inst->sched.timeout_ms)) {
+                return false;
+            }
+            bool closed = buffer->closed || esp01_ip_close(inst, link_id_);
+            buffer->reset(false);
+            esp01_unlock(inst);
+            return closed;
+        }
+
+    private:
+        esp01_inst_t *inst_ = nullptr;
+        int link_id_ = ESP01_UNDEFINED;
+        SocketBuffer *buffer_ = nullptr;
+    };
+
+    // ESP01 communication instance
+    class Esp01 {
+    public:
+        /*!
+         * Initialize a communication with ESP01 device.
+         *
+         * @param uart_inst UART instance
+         * @param baud_rate Communication baud rate. @see ESP01_DEFAULT_BAUD_RATE
+         * @param tx_pin TX pin number
+         * @param rx_pin RX pin number
+         */
+        Esp01(uart_inst_t *uart_inst, uint baud_rate, uint tx_pin, uint rx_pin)
+                : inst_(esp01_init(uart_inst, baud_rate, tx_pin, rx_pin)), links_(std::make_unique<Links>()) {
+            esp01_set_urc_handler(inst_, &Esp01::urc_trampoline, links_.get());
+        }
+
+        Esp01(const Esp01 &) = delete;
+
+        Esp01 &operator=(const Esp01 &) = delete;
+
+        Esp01(Esp01 &&other) noexcept: inst_(std::exchange(other.inst_, nullptr)), links_(std::move(other.links_)) {}
+
+        Esp01 &operator=(Esp01 &&other) noexcept {
+            if (this != &other) {
+                if (inst_ != nullptr) {
+                    esp01_deinit(inst_);
+                }
+                inst_ = std::exchange(other.inst_, nullptr);
+                links_ = std::move(other.links_);
+            }
+            return *this;
+        }
+
+        ~Esp01() {
+            if (inst_ != nullptr) {
+                esp01_deinit(inst_);
+            }
+        }
+
+        // Underlying instance (for the C API)
+        esp01_inst_t *get() const {
+            return inst_;
+        }
+
+        /*!
+         * Set the handler of the unsolicited result codes that don't belong to a socket (the instance handler is
+         * the socket receive buffers). @see esp01_urc_handler_t
+         *
+         * @param handler Unsolicited result code handler (NULL to discard them)
+         * @param ctx User context passed to the handler
+         * @return True if the handler was set, false if the instance couldn't be locked
+         */
+        bool set_urc_handler(esp01_urc_handler_t handler, void *ctx) const {
+            if (!esp01_lock(inst_, ESP01_PRIORITY_NORMAL, inst_->sched.timeout_ms)) {
+                return false;
+            }
+            links_->next = handler;
+            links_->next_ctx = ctx;
+            esp01_unlock(inst_);
+            return true;
+        }
+
+        bool test() const {
+            return esp01_test(inst_);
+        }
+
+        bool reset() const {
+            return esp01_reset(inst_);
+        }
+
+        Version version() const {
+            esp01_version_t ver;
+            if (!esp01_get_version(inst_, &ver)) {
+                return Version();
+            }
+            return Version(ver);
+        }
+
+        /*!
+         * Send a command without params.
+         *
+         * @param cmd Command built by esp01::command
+         * @param timeout_ms Command timeout in ms
+         * @return The device response
+         */
+        template<std::size_t N>
+        Response at(const Command<N> &cmd, uint timeout_ms = ESP01_DEFAULT_TIMEOUT) const {
+            return Response(esp01_at_cmd(inst_, timeout_ms, AT_EXECUTE, cmd.c_str(), "\n"));
+        }
+
+        /*!
+         * Send a command with params.
+         *
+         * @param cmd Command built by esp01::command
+         * @param params Command params (without line ending)
+         * @param timeout_ms Command timeout in ms
+         * @return The device response, empty if the command overflows
+         */
+        template<std::size_t N>
+        Response at(const Command<N> &cmd, std::string_view params, uint timeout_ms = ESP01_DEFAULT_TIMEOUT) const {
+            char line[ESP01_CMD_LENGTH + 2];
+            if (cmd.size() + params.size() >= ESP01_CMD_LENGTH) {
+                return Response();
+            }
+            std::memcpy(line, params.data(), params.size());
+            line[params.size()] = '\n';
+            line[params.size() + 1] = '\0';
+            return Response(esp01_at_cmd(inst_, timeout_ms, AT_EXECUTE, cmd.c_str(), line));
+        }
+
+        /*!
+         * Send a command without params and stream the response to a sink.
+         * The sink is called as bool(std::string_view chunk), a chunk with a null data() means that the data received
+         * so far must be discarded. @see esp01_rsp_sink_t
+         *
+         * @param cmd Command built by esp01::command
+         * @param sink Response sink
+         * @param timeout_ms Command timeout in ms
+         * @return The response status
+         */
+        template<std::size_t N, typename Sink>
+        esp01_rsp_status_t stream(const Command<N> &cmd, Sink &&sink, uint timeout_ms = ESP01_DEFAULT_TIMEOUT) const {
+            using SinkType = std::remove_reference_t<Sink>;
+            void *ctx = const_cast<void *>(static_cast<const void *>(&sink));
+            return esp01_at_cmd_stream(inst_, timeout_ms, &Esp01::sink_trampoline<SinkType>, ctx, AT_EXECUTE,
+                                       cmd.c_str(), "\n");
+        }
+
+        /*!
+         * Open a connection, its data is buffered from the connection on.
+         *
+         * @param link_id Link ID (ESP01_UNDEFINED in single connection mode)
+         * @param type Connection type
+         * @param host Remote host
+         * @param port Remote port
+         * @return The connection, empty if it couldn't be opened (or if the link is used by another socket)
+         */
+        Socket connect(int link_id, esp01_ip_type_t type, const char *host, uint port) const {
+            SocketBuffer *buffer = links_->find(link_id);
+            if (buffer == nullptr || !esp01_lock(inst_, ESP01_PRIORITY_NORMAL, inst_->sched.timeout_ms)) {
+                return Socket();
+            }
+
+            // The buffer is opened first, the device may send data right after the CONNECT event
+            bool connected = false;
+            if (!buffer->open) {
+                buffer->reset(true);
+                connected = esp01_ip_connect(inst_, link_id, type, host, port);
+                if (!connected) {
+                    buffer->reset(false);
+                }
+            }
+
+            esp01_unlock(inst_);
+            return connected ? Socket(inst_, link_id, buffer) : Socket();
+        }
+
+    private:
+        // Receive buffers of the links (the last one is the single connection mode link)
+        struct Links {
+            std::array<SocketBuffer, ESP01_MAX_LINKS + 1> buffers;
+            esp01_urc_handler_t next = nullptr;
+            void *next_ctx = nullptr;
+
+            SocketBuffer *find(int link_id) {
+                if (link_id == ESP01_UNDEFINED) {
+                    return &buffers[ESP01_MAX_LINKS];
+                }
+                if (link_id < 0 || link_id >= ESP01_MAX_LINKS) {
+                    return nullptr;
+                }
+                return &buffers[link_id];
+            }
+        };
+
+        esp01_inst_t *inst_ = nullptr;
+        std::unique_ptr<Links> links_;
+
+        // Events of the open sockets go to their buffers, the others to the user handler
+        static void urc_trampoline(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len,
+                                   void *ctx) {
+            Links &links = *static_cast<Links *>(ctx);
+            SocketBuffer *buffer = links.find(link_id);
+            if (buffer != nullptr && buffer->open) {
+                if (urc == ESP01_URC_DATA) {
+                    buffer->push(data, len);
+                } else if (urc == ESP01_URC_CLOSED) {
+                    buffer->closed = true;
+                }
+                return;
+            }
+            if (links.next != nullptr) {
+                links.next(inst, urc, link_id, data, len, links.next_ctx);
+            }
+        }
+
+        template<typename Sink>
+        static bool sink_trampoline(const char *chunk, size_t len, void *ctx) {
+            Sink &sink = *static_cast<Sink *>(ctx);
+            return sink(chunk != nullptr ? std::string_view(chunk, len) : std::string_view());
+        }
+    };
+
+}
+
+#endif
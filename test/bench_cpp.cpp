@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "esp01.hpp"
+#include "esp01_mock.h"
+
+// The C++ wrapper against the C API on the same scenario (a query, a request and its response per round trip). Both
+// must put the same bytes on the wire in the same simulated time, the host time shows the overhead of the wrapper
+// (most of it is the simulation itself).
+
+#define BENCH_ROUND_TRIPS 200
+#define BENCH_RUNS 5
+#define BENCH_REQUEST_LENGTH 64
+#define BENCH_RESPONSE_LENGTH 256
+
+struct bench_result {
+    uint64_t sim_us;
+    size_t rx_bytes;
+    size_t tx_bytes;
+    double host_us;
+} typedef bench_result_t;
+
+static char request[BENCH_REQUEST_LENGTH];
+static size_t requested;
+static size_t received;
+
+// Peer: answer each whole request
+static bool bench_peer(int link_id, const char *data, size_t len, uint64_t at_us, void *ctx) {
+    requested += len;
+    if (requested < BENCH_REQUEST_LENGTH) {
+        return false;
+    }
+
+    requested -= BENCH_REQUEST_LENGTH;
+    char response[BENCH_RESPONSE_LENGTH];
+    std::memset(response, 'r', sizeof(response));
+    mock_ipd_at(at_us + mock_default_config().net_delay_us, link_id, response, sizeof(response));
+    return true;
+}
+
+static void bench_urc(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len, void *ctx) {
+    if (urc == ESP01_URC_DATA && link_id == 0) {
+        received += len;
+    }
+}
+
+static void bench_c(void) {
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_set_urc_handler(inst, bench_urc, NULL);
+    MOCK_CHECK(esp01_ip_connect(inst, 0, ESP01_IP_TCP, "192.168.4.2", 5000));
+
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_QUERY, AT_RAM, "\n");
+        MOCK_CHECK(esp01_rsp_ok(rsp));
+        free(rsp);
+
+        MOCK_CHECK(esp01_ip_send(inst, 0, request, BENCH_REQUEST_LENGTH));
+        received = 0;
+        while (received < BENCH_RESPONSE_LENGTH) {
+            esp01_poll(inst, 1);
+        }
+    }
+
+    MOCK_CHECK(esp01_ip_close(inst, 0));
+    esp01_deinit(inst);
+}
+
+static void bench_cpp(void) {
+    constexpr auto query = esp01::command<AT_QUERY>(AT_RAM);
+    esp01::Esp01 esp(uart0, 115200, 0, 1);
+    esp01::Socket socket = esp.connect(0, ESP01_IP_TCP, "192.168.4.2", 5000);
+    MOCK_CHECK(socket);
+
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        MOCK_CHECK(esp.at(query));
+
+        MOCK_CHECK(socket.send(std::string_view(request, BENCH_REQUEST_LENGTH)));
+        size_t len = 0;
+        while (len < BENCH_RESPONSE_LENGTH) {
+            len += socket.receive([](std::string_view chunk) {
+                MOCK_CHECK(chunk.find_first_not_of('r') == std::string_view::npos);
+            }, 1);
+        }
+    }
+
+    MOCK_CHECK(socket.close());
+}
+
+static bench_result_t bench(void (*run)(void)) {
+    bench_result_t result = {0, 0, 0, 0};
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        mock_reset(NULL);
+        mock_set_peer_handler(bench_peer, NULL);
+        requested = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double, std::micro> host = std::chrono::steady_clock::now() - start;
+
+        result.host_us = i == 0 ? host.count() : std::min(result.host_us, host.count());
+        result.sim_us = mock_now_us();
+        result.rx_bytes = mock_rx_bytes();
+        result.tx_bytes = mock_tx_bytes();
+    }
+    return result;
+}
+
+int main(void) {
+    std::memset(request, 'q', sizeof(request));
+
+    printf("C++ wrapper vs C API, %u round trips (AT+SYSRAM?, %u bytes request, %u bytes response)\n",
+           BENCH_ROUND_TRIPS, BENCH_REQUEST_LENGTH, BENCH_RESPONSE_LENGTH);
+    printf("path   simulated (ms)   bytes to module   bytes from module   host (us/round trip)\n");
+
+    bench_result_t c = bench(bench_c);
+    bench_result_t cpp = bench(bench_cpp);
+    printf("C      %14.1f %17zu %19zu %22.2f\n", c.sim_us / 1000.0, c.rx_bytes, c.tx_bytes,
+           c.host_us / BENCH_ROUND_TRIPS);
+    printf("C++    %14.1f %17zu %19zu %22.2f\n", cpp.sim_us / 1000.0, cpp.rx_bytes, cpp.tx_bytes,
+           cpp.host_us / BENCH_ROUND_TRIPS);
+
+    MOCK_CHECK(cpp.sim_us == c.sim_us);
+    MOCK_CHECK(cpp.rx_bytes == c.rx_bytes && cpp.tx_bytes == c.tx_bytes);
+    return 0;
+}
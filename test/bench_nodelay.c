@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Small message round trips: each request is written as a header and a body (two sends), the peer answers once it has
+// the whole request. With Nagle's algorithm the body waits for the ACK of the header, which the peer delays.
+
+#define BENCH_ROUND_TRIPS 50
+#define BENCH_HEADER_LENGTH 4
+#define BENCH_BODY_LENGTH 28
+#define BENCH_RESPONSE_LENGTH 32
+
+static size_t received;
+static bool answered;
+
+// Peer: answer a whole request
+static bool bench_peer(int link_id, const char *data, size_t len, uint64_t at_us, void *ctx) {
+    received += len;
+    if (received < BENCH_HEADER_LENGTH + BENCH_BODY_LENGTH) {
+        return false;
+    }
+
+    received = 0;
+    char response[BENCH_RESPONSE_LENGTH];
+    memset(response, 'r', sizeof(response));
+    mock_ipd_at(at_us + mock_default_config().net_delay_us, link_id, response, sizeof(response));
+    return true;
+}
+
+static void bench_urc(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len, void *ctx) {
+    if (urc == ESP01_URC_DATA) {
+        answered = true;
+    }
+}
+
+static double bench(bool nodelay) {
+    mock_reset(NULL);
+    received = 0;
+    mock_set_peer_handler(bench_peer, NULL);
+
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_set_urc_handler(inst, bench_urc, NULL);
+    esp01_socket_options_t options = {-1, nodelay, 0, 0, ESP01_SOCKET_NODELAY};
+    esp01_set_default_socket_options(inst, options);
+    MOCK_CHECK(esp01_ip_connect(inst, 0, ESP01_IP_TCP, "192.168.4.2", 5000));
+
+    char header[BENCH_HEADER_LENGTH];
+    char body[BENCH_BODY_LENGTH];
+    memset(header, 'h', sizeof(header));
+    memset(body, 'b', sizeof(body));
+
+    uint64_t total_us = 0;
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        uint64_t start_us = mock_now_us();
+        answered = false;
+        MOCK_CHECK(esp01_ip_send(inst, 0, header, sizeof(header)));
+        MOCK_CHECK(esp01_ip_send(inst, 0, body, sizeof(body)));
+        while (!answered) {
+            MOCK_CHECK(mock_now_us() - start_us < 1000000);
+            esp01_poll(inst, 1);
+        }
+        total_us += mock_now_us() - start_us;
+    }
+
+    esp01_deinit(inst);
+    return total_us / 1000.0 / BENCH_ROUND_TRIPS;
+}
+
+int main(void) {
+    mock_config_t config = mock_default_config();
+    printf("Round trips of %u+%u bytes requests and %u bytes responses, %u ms network delay, %u ms delayed ACK\n",
+           BENCH_HEADER_LENGTH, BENCH_BODY_LENGTH, BENCH_RESPONSE_LENGTH, config.net_delay_us / 1000,
+           config.ack_delay_us / 1000);
+
+    double nagle_ms = bench(false);
+    double nodelay_ms = bench(true);
+    printf("TCP_NODELAY off: %6.1f ms\n", nagle_ms);
+    printf("TCP_NODELAY on:  %6.1f ms\n", nodelay_ms);
+
+    MOCK_CHECK(nodelay_ms < nagle_ms);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Records of a length unknown in advance, produced in small pieces: each piece sent with AT+CIPSEND, the whole record
+// buffered then sent with AT+CIPSEND, or each piece streamed into AT+CIPSENDEX frames
+
+#define BENCH_RECORDS 20
+#define BENCH_PIECES 64
+#define BENCH_PIECE_LENGTH 48
+
+enum bench_mode {
+    BENCH_SEND_PIECES,
+    BENCH_SEND_BUFFERED,
+    BENCH_SEND_STREAM,
+} typedef bench_mode_t;
+
+static const char *bench_names[] = {"AT+CIPSEND per piece", "AT+CIPSEND buffered", "AT+CIPSENDEX stream"};
+
+static char piece[BENCH_PIECE_LENGTH];
+static char record[BENCH_PIECES * BENCH_PIECE_LENGTH];
+
+static void bench_record(esp01_inst_t *inst, bench_mode_t mode) {
+    esp01_send_stream_t stream;
+    size_t len = 0;
+
+    switch (mode) {
+        case BENCH_SEND_PIECES:
+            for (int i = 0; i < BENCH_PIECES; i++) {
+                MOCK_CHECK(esp01_ip_send(inst, 0, piece, sizeof(piece)));
+            }
+            break;
+        case BENCH_SEND_BUFFERED:
+            for (int i = 0; i < BENCH_PIECES; i++) {
+                memcpy(record + len, piece, sizeof(piece));
+                len += sizeof(piece);
+            }
+            MOCK_CHECK(esp01_ip_send(inst, 0, record, len));
+            break;
+        case BENCH_SEND_STREAM:
+            MOCK_CHECK(esp01_ip_send_begin(inst, &stream, 0));
+            for (int i = 0; i < BENCH_PIECES; i++) {
+                MOCK_CHECK(esp01_ip_send_write(&stream, piece, sizeof(piece)));
+            }
+            MOCK_CHECK(esp01_ip_send_end(&stream));
+            break;
+    }
+}
+
+// Throughput in kB/s (simulated time)
+static double bench(bench_mode_t mode) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    MOCK_CHECK(esp01_ip_connect(inst, 0, ESP01_IP_TCP, "192.168.4.2", 5000));
+
+    uint64_t start_us = mock_now_us();
+    for (int i = 0; i < BENCH_RECORDS; i++) {
+        bench_record(inst, mode);
+    }
+    uint64_t elapsed_us = mock_now_us() - start_us;
+
+    size_t total = (size_t) BENCH_RECORDS * BENCH_PIECES * BENCH_PIECE_LENGTH;
+    MOCK_CHECK(mock_link(0)->tx_bytes == total);
+    double throughput = total / 1024.0 / (elapsed_us / 1e6);
+    printf("%-22s %8.1f %10u %10.1f\n", bench_names[mode], elapsed_us / 1000.0, mock_link(0)->segments, throughput);
+
+    esp01_deinit(inst);
+    return throughput;
+}
+
+int main(void) {
+    memset(piece, 'p', sizeof(piece));
+
+    printf("%u records of %u pieces of %u bytes, 115200 baud\n", BENCH_RECORDS, BENCH_PIECES, BENCH_PIECE_LENGTH);
+    printf("mode                   time (ms)  segments      kB/s\n");
+    double pieces = bench(BENCH_SEND_PIECES);
+    double buffered = bench(BENCH_SEND_BUFFERED);
+    double stream = bench(BENCH_SEND_STREAM);
+
+    // Streaming saves the command of each piece, and only costs the frame commands over the buffered send
+    MOCK_CHECK(stream > pieces);
+    MOCK_CHECK(stream > 0.9 * buffered);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Concurrent connection throughput: each client sends a request, waits for the response, and sends the next one
+
+#define BENCH_DURATION_US 10000000
+#define BENCH_REQUEST_LENGTH 64
+#define BENCH_RESPONSE_LENGTH 256
+
+struct bench_client {
+    size_t received;
+    uint requests;
+    uint64_t sent_us;
+    uint64_t latency_us;
+} typedef bench_client_t;
+
+static bench_client_t clients[ESP01_SERVER_MAX_CONNECTIONS];
+static char request[BENCH_REQUEST_LENGTH];
+static char response[BENCH_RESPONSE_LENGTH];
+
+static void bench_request(int link_id, uint64_t at_us) {
+    clients[link_id].sent_us = at_us;
+    mock_ipd_at(at_us, link_id, request, BENCH_REQUEST_LENGTH);
+}
+
+// Client side: a whole response triggers the next request
+static bool bench_peer(int link_id, const char *data, size_t len, uint64_t at_us, void *ctx) {
+    bench_client_t *client = &clients[link_id];
+    client->received += len;
+    if (client->received < BENCH_RESPONSE_LENGTH) {
+        return false;
+    }
+
+    client->received -= BENCH_RESPONSE_LENGTH;
+    client->requests++;
+    client->latency_us += at_us - client->sent_us;
+    bench_request(link_id, at_us + mock_default_config().net_delay_us);
+    return true;
+}
+
+// Server side: answer each whole request
+static size_t bench_on_data(esp01_server_t *server, esp01_server_conn_t *conn, const char *data, size_t len,
+                            void *ctx) {
+    size_t consumed = 0;
+    while (len - consumed >= BENCH_REQUEST_LENGTH) {
+        esp01_ip_send(server->inst, conn->link_id, response, BENCH_RESPONSE_LENGTH);
+        consumed += BENCH_REQUEST_LENGTH;
+    }
+    return consumed;
+}
+
+static void bench(uint connections) {
+    mock_reset(NULL);
+    memset(clients, 0, sizeof(clients));
+
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_server_t *server = esp01_server_init(inst, 80, ESP01_SERVER_MAX_CONNECTIONS, 10);
+    MOCK_CHECK(server != NULL);
+    esp01_server_set_handlers(server, NULL, bench_on_data, NULL, NULL);
+    mock_set_peer_handler(bench_peer, NULL);
+
+    for (uint i = 0; i < connections; i++) {
+        char event[32];
+        snprintf(event, sizeof(event), "%u,CONNECT\r\n", i);
+        mock_send(0, event);
+        mock_link(i)->open = true;
+        bench_request(i, mock_now_us() + 1000);
+    }
+
+    uint64_t start_us = mock_now_us();
+    while (mock_now_us() - start_us < BENCH_DURATION_US) {
+        esp01_server_poll(server, 10);
+    }
+
+    uint requests = 0;
+    uint64_t latency_us = 0;
+    for (uint i = 0; i < connections; i++) {
+        requests += clients[i].requests;
+        latency_us += clients[i].latency_us;
+    }
+    MOCK_CHECK(requests > 0);
+    MOCK_CHECK(server->stats.dropped_bytes == 0);
+
+    double seconds = BENCH_DURATION_US / 1e6;
+    printf("%11u %10.1f %12.1f %14.1f\n", connections, requests / seconds,
+           requests * (double) (BENCH_REQUEST_LENGTH + BENCH_RESPONSE_LENGTH) / seconds / 1024,
+           latency_us / 1000.0 / requests);
+
+    esp01_server_deinit(server);
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    memset(request, 'q', sizeof(request));
+    memset(response, 'r', sizeof(response));
+
+    printf("Server throughput, %u bytes requests, %u bytes responses, 115200 baud, %u s\n", BENCH_REQUEST_LENGTH,
+           BENCH_RESPONSE_LENGTH, BENCH_DURATION_US / 1000000);
+    printf("connections      req/s   kB/s (app)   latency (ms)\n");
+    for (uint connections = 1; connections <= ESP01_SERVER_MAX_CONNECTIONS; connections++) {
+        bench(connections);
+    }
+    return 0;
+}
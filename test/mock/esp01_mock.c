@@ -0,0 +1,658 @@
+#include "esp01_mock.h"
+
+#include <string.h>
+
+#include "esp01.h"
+
+// Simulated ESP01 module behind a simulated UART, on a virtual clock (times are in ns internally)
+
+struct uart_inst {
+    int index;
+};
+
+static struct uart_inst mock_uarts[2] = {{0}, {1}};
+
+uart_inst_t *const uart0 = &mock_uarts[0];
+uart_inst_t *const uart1 = &mock_uarts[1];
+
+// Output of the module waiting to be put on the wire
+struct mock_message {
+    uint64_t at_ns;
+    uint32_t seq;
+    bool framing;
+    size_t len;
+    char data[];
+} typedef mock_message_t;
+
+// Byte on the wire (the data register value and its arrival time)
+struct mock_byte {
+    uint64_t at_ns;
+    uint32_t dr;
+} typedef mock_byte_t;
+
+enum mock_rx_state {
+    MOCK_RX_LINE,
+    MOCK_RX_DATA,
+    MOCK_RX_DATA_EX,
+} typedef mock_rx_state_t;
+
+static struct {
+    mock_config_t config;
+    uint64_t now_ns;
+    uint64_t byte_ns;
+    bool translate_crlf;
+    uint exception;
+
+    // Other tasks contending for the instance lock
+    lock_owner_id_t owner;
+    mock_task_t wait_task;
+    void *wait_ctx;
+
+    // Module output
+    mock_message_t *messages[MOCK_MESSAGES];
+    uint message_count;
+    uint32_t seq;
+    bool framing;
+    mock_byte_t fifo[MOCK_FIFO_LENGTH];
+    uint fifo_head;
+    uint fifo_len;
+    uint64_t wire_free_ns;
+    size_t tx_bytes;
+    uart_hw_t hw;
+
+    // Module input
+    mock_rx_state_t state;
+    char line[MOCK_LINE_LENGTH + 1];
+    size_t line_len;
+    char data[ESP01_SEND_LENGTH];
+    size_t data_len;
+    size_t data_expected;
+    bool data_escape;
+    int data_link;
+    uint64_t busy_until_ns;
+    size_t rx_bytes;
+
+    // Module state
+    bool multiple;
+    mock_link_t links[MOCK_LINKS];
+    char history[64][MOCK_LINE_LENGTH + 1];
+    uint history_len;
+    uint commands;
+
+    mock_cmd_handler_t cmd_handler;
+    void *cmd_ctx;
+    mock_peer_handler_t peer_handler;
+    void *peer_ctx;
+} mock;
+
+static void mock_link_reset(mock_link_t *link) {
+    memset(link, 0, sizeof(mock_link_t));
+    link->so_linger = -1;
+    link->so_sndtimeo = 0;
+    link->keep_alive = 0;
+}
+
+mock_config_t mock_default_config(void) {
+    mock_config_t config = {115200, 200, 1000, 5000, 40000, 1460, 20000};
+    return config;
+}
+
+void mock_reset(const mock_config_t *config) {
+    for (uint i = 0; i < mock.message_count; i++) {
+        free(mock.messages[i]);
+    }
+    memset(&mock, 0, sizeof(mock));
+
+    mock.config = config != NULL ? *config : mock_default_config();
+    mock.byte_ns = 10000000000ull / mock.config.baud_rate;
+    mock.multiple = true;
+    for (int i = 0; i < MOCK_LINKS; i++) {
+        mock_link_reset(&mock.links[i]);
+    }
+}
+
+uint64_t mock_now_us(void) {
+    return mock.now_ns / 1000;
+}
+
+void mock_set_cmd_handler(mock_cmd_handler_t handler, void *ctx) {
+    mock.cmd_handler = handler;
+    mock.cmd_ctx = ctx;
+}
+
+void mock_set_peer_handler(mock_peer_handler_t handler, void *ctx) {
+    mock.peer_handler = handler;
+    mock.peer_ctx = ctx;
+}
+
+static void mock_send_at_ns(uint64_t at_ns, const char *data, size_t len) {
+    MOCK_CHECK(mock.message_count < MOCK_MESSAGES);
+
+    mock_message_t *message = malloc(sizeof(mock_message_t) + len);
+    message->at_ns = at_ns;
+    message->seq = mock.seq++;
+    message->framing = mock.framing;
+    message->len = len;
+    memcpy(message->data, data, len);
+    mock.framing = false;
+
+    mock.messages[mock.message_count++] = message;
+}
+
+void mock_send_at(uint64_t at_us, const char *data, size_t len) {
+    mock_send_at_ns(at_us * 1000, data, len);
+}
+
+void mock_send(uint32_t delay_us, const char *str) {
+    mock_send_at_ns(mock.now_ns + (uint64_t) delay_us * 1000, str, strlen(str));
+}
+
+void mock_reply(uint32_t delay_us, const char *str) {
+    uint64_t at_ns = mock.now_ns + (uint64_t) delay_us * 1000;
+    mock_send_at_ns(at_ns, str, strlen(str));
+    if (at_ns > mock.busy_until_ns) {
+        mock.busy_until_ns = at_ns;
+    }
+}
+
+void mock_ipd_at(uint64_t at_us, int link_id, const char *data, size_t len) {
+    char header[32];
+    int header_len;
+    if (mock.multiple) {
+        header_len = sprintf(header, "\r\n+IPD,%d,%u:", link_id, (uint) len);
+    } else {
+        header_len = sprintf(header, "\r\n+IPD,%u:", (uint) len);
+    }
+
+    char *message = malloc(header_len + len);
+    memcpy(message, header, header_len);
+    memcpy(message + header_len, data, len);
+    mock_send_at_ns(at_us * 1000, message, header_len + len);
+    free(message);
+}
+
+void mock_framing_error(void) {
+    mock.framing = true;
+}
+
+uint mock_command_count(const char *prefix) {
+    uint count = 0;
+    uint n = mock.history_len < 64 ? mock.history_len : 64;
+    for (uint i = 0; i < n; i++) {
+        if (strncmp(mock.history[i], prefix, strlen(prefix)) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+const char *mock_last_command(void) {
+    return mock.history_len > 0 ? mock.history[(mock.history_len - 1) % 64] : "";
+}
+
+mock_link_t *mock_link(int link_id) {
+    return &mock.links[link_id < 0 ? 0 : link_id];
+}
+
+void mock_set_multiple(bool multiple) {
+    mock.multiple = multiple;
+}
+
+void mock_set_exception(uint exception) {
+    mock.exception = exception;
+}
+
+void mock_set_owner(lock_owner_id_t owner) {
+    mock.owner = owner;
+}
+
+void mock_set_wait_task(mock_task_t task, void *ctx) {
+    mock.wait_task = task;
+    mock.wait_ctx = ctx;
+}
+
+size_t mock_rx_bytes(void) {
+    return mock.rx_bytes;
+}
+
+size_t mock_tx_bytes(void) {
+    return mock.tx_bytes;
+}
+
+// Put the earliest message on the wire (after the bytes already on it)
+static bool mock_wire_next(uint64_t deadline_ns) {
+    int next = -1;
+    for (uint i = 0; i < mock.message_count; i++) {
+        mock_message_t *m = mock.messages[i];
+        if (next < 0 || m->at_ns < mock.messages[next]->at_ns ||
+            (m->at_ns == mock.messages[next]->at_ns && (int32_t) (m->seq - mock.messages[next]->seq) < 0)) {
+            next = i;
+        }
+    }
+    if (next < 0 || mock.messages[next]->at_ns > deadline_ns) {
+        return false;
+    }
+
+    mock_message_t *m = mock.messages[next];
+    mock.messages[next] = mock.messages[--mock.message_count];
+
+    uint64_t start_ns = m->at_ns > mock.wire_free_ns ? m->at_ns : mock.wire_free_ns;
+    for (size_t i = 0; i < m->len; i++) {
+        MOCK_CHECK(mock.fifo_len < MOCK_FIFO_LENGTH);
+        mock_byte_t *byte = &mock.fifo[(mock.fifo_head + mock.fifo_len++) % MOCK_FIFO_LENGTH];
+        byte->at_ns = start_ns + (i + 1) * mock.byte_ns;
+        byte->dr = (uint8_t) m->data[i];
+        if (m->framing && i == 0) {
+            byte->dr |= UART_UARTDR_FE_BITS;
+        }
+    }
+    mock.wire_free_ns = start_ns + m->len * mock.byte_ns;
+    mock.tx_bytes += m->len;
+
+    free(m);
+    return true;
+}
+
+// Send a segment to the peer (Nagle holds a small segment while data is unacknowledged)
+static void mock_link_send(int link_id, const char *data, size_t len, uint64_t at_ns) {
+    mock_link_t *link = mock_link(link_id);
+    if (link->tcp_nodelay != 1 && at_ns < link->unacked_ns && len < mock.config.mss) {
+        at_ns = link->unacked_ns;
+    }
+
+    uint64_t arrival_ns = at_ns + (uint64_t) mock.config.net_delay_us * 1000;
+    bool answered = false;
+    if (mock.peer_handler != NULL) {
+        answered = mock.peer_handler(link_id, data, len, arrival_ns / 1000, mock.peer_ctx);
+    }
+
+    uint64_t ack_ns = arrival_ns + (uint64_t) mock.config.net_delay_us * 1000;
+    if (!answered) {
+        ack_ns += (uint64_t) mock.config.ack_delay_us * 1000;
+    }
+    if (ack_ns > link->unacked_ns) {
+        link->unacked_ns = ack_ns;
+    }
+    link->segments++;
+    link->tx_bytes += len;
+}
+
+// Data of AT+CIPSEND/AT+CIPSENDEX fully received
+static void mock_data_done(void) {
+    char rsp[64];
+    sprintf(rsp, "\r\nRecv %u bytes\r\n", (uint) mock.data_len);
+    mock_send(0, rsp);
+    mock_reply(mock.config.send_latency_us, "\r\nSEND OK\r\n");
+
+    mock_link_send(mock.data_link, mock.data, mock.data_len,
+                   mock.now_ns + (uint64_t) mock.config.send_latency_us * 1000);
+    mock.state = MOCK_RX_LINE;
+}
+
+// Parse the link ID and the length of a send command
+static bool mock_parse_send(const char *params, mock_rx_state_t state) {
+    int link_id = 0;
+    uint len;
+    if (mock.multiple ? sscanf(params, "%d,%u", &link_id, &len) != 2 : sscanf(params, "%u", &len) != 1) {
+        return false;
+    }
+    if (link_id < 0 || link_id >= MOCK_LINKS || !mock.links[link_id].open || len == 0 || len > ESP01_SEND_LENGTH) {
+        return false;
+    }
+
+    mock_reply(mock.config.cmd_latency_us, "\r\nOK\r\n> ");
+    mock.state = state;
+    mock.data_link = link_id;
+    mock.data_len = 0;
+    mock.data_expected = len;
+    mock.data_escape = false;
+    return true;
+}
+
+// Parse the socket options (empty fields keep the value, a trailing empty field is refused like the firmware does)
+static bool mock_parse_socket_options(const char *params) {
+    int link_id = 0;
+    if (mock.multiple) {
+        if (sscanf(params, "%d", &link_id) != 1 || link_id < 0 || link_id >= MOCK_LINKS) {
+            return false;
+        }
+        params = strchr(params, ',');
+        if (params == NULL) {
+            return false;
+        }
+        params++;
+    }
+
+    size_t params_len = strlen(params);
+    if (params_len == 0 || params[params_len - 1] == ',') {
+        return false;
+    }
+
+    mock_link_t *link = &mock.links[link_id];
+    int *values[] = {&link->so_linger, &link->tcp_nodelay, &link->so_sndtimeo, &link->keep_alive};
+    const char *c = params;
+    for (int i = 0; i < 4 && *c != '\0'; i++) {
+        if (*c != ',') {
+            *values[i] = (int) strtol(c, (char **) &c, 10);
+        }
+        if (*c == ',') {
+            c++;
+        } else if (*c != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Default behaviour of the module
+static void mock_default_cmd(const char *cmd) {
+    uint32_t latency = mock.config.cmd_latency_us;
+    char rsp[512];
+    int link_id;
+
+    if (strcmp(cmd, "AT") == 0 || strncmp(cmd, "AT+CIPSERVER", 12) == 0 || strncmp(cmd, "AT+CIPSTO=", 10) == 0) {
+        mock_reply(latency, "\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+CIPMUX=", 10) == 0) {
+        mock.multiple = cmd[10] == '1';
+        mock_reply(latency, "\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+CIPSTART=", 12) == 0) {
+        link_id = 0;
+        if (mock.multiple && (sscanf(cmd + 12, "%d", &link_id) != 1 || link_id < 0 || link_id >= MOCK_LINKS)) {
+            mock_reply(latency, "\r\nERROR\r\n");
+            return;
+        }
+        mock_link_reset(&mock.links[link_id]);
+        mock.links[link_id].open = true;
+        if (mock.multiple) {
+            sprintf(rsp, "%d,CONNECT\r\n\r\nOK\r\n", link_id);
+        } else {
+            sprintf(rsp, "CONNECT\r\n\r\nOK\r\n");
+        }
+        mock_reply(latency + 2 * mock.config.net_delay_us, rsp);
+    } else if (strncmp(cmd, "AT+CIPCLOSE", 11) == 0) {
+        link_id = 0;
+        if (cmd[11] == '=') {
+            link_id = atoi(cmd + 12);
+        }
+        if (link_id < 0 || link_id >= MOCK_LINKS || !mock.links[link_id].open) {
+            mock_reply(latency, "\r\nERROR\r\n");
+            return;
+        }
+        mock.links[link_id].open = false;
+        if (mock.multiple) {
+            sprintf(rsp, "%d,CLOSED\r\n\r\nOK\r\n", link_id);
+        } else {
+            sprintf(rsp, "CLOSED\r\n\r\nOK\r\n");
+        }
+        mock_reply(latency, rsp);
+    } else if (strncmp(cmd, "AT+CIPSENDEX=", 13) == 0) {
+        if (!mock_parse_send(cmd + 13, MOCK_RX_DATA_EX)) {
+            mock_reply(latency, "\r\nERROR\r\n");
+        }
+    } else if (strncmp(cmd, "AT+CIPSEND=", 11) == 0) {
+        if (!mock_parse_send(cmd + 11, MOCK_RX_DATA)) {
+            mock_reply(latency, "\r\nERROR\r\n");
+        }
+    } else if (strcmp(cmd, "AT+CIPTCPOPT?") == 0) {
+        int len = 0;
+        for (int i = 0; i < MOCK_LINKS; i++) {
+            mock_link_t *link = &mock.links[i];
+            if (link->open) {
+                len += sprintf(rsp + len, "+CIPTCPOPT:%d,%d,%d,%d,%d\r\n", i, link->so_linger, link->tcp_nodelay,
+                               link->so_sndtimeo, link->keep_alive);
+            }
+        }
+        sprintf(rsp + len, "\r\nOK\r\n");
+        mock_reply(latency, rsp);
+    } else if (strncmp(cmd, "AT+CIPTCPOPT=", 13) == 0) {
+        mock_reply(latency, mock_parse_socket_options(cmd + 13) ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+    } else if (strcmp(cmd, "AT+SYSRAM?") == 0 && mock.config.free_heap != ESP01_UNDEFINED) {
+        sprintf(rsp, "+SYSRAM:%d,%d\r\n\r\nOK\r\n", mock.config.free_heap, mock.config.free_heap / 2);
+        mock_reply(latency, rsp);
+    } else {
+        mock_reply(latency, "\r\nERROR\r\n");
+    }
+}
+
+// Command line received by the module
+static void mock_line(void) {
+    char *cmd = mock.line;
+    while (mock.line_len > 0 && (cmd[mock.line_len - 1] == '\r' || cmd[mock.line_len - 1] == '\n')) {
+        cmd[--mock.line_len] = '\0';
+    }
+    if (mock.line_len == 0) {
+        return;
+    }
+
+    strcpy(mock.history[mock.history_len++ % 64], cmd);
+
+    // The module is still processing the previous command
+    if (mock.now_ns < mock.busy_until_ns) {
+        mock_send(0, "busy p...\r\n");
+        return;
+    }
+
+    char echo[MOCK_LINE_LENGTH + 3];
+    sprintf(echo, "%s\r\n", cmd);
+    mock_send(0, echo);
+
+    if (mock.cmd_handler == NULL || !mock.cmd_handler(cmd, mock.cmd_ctx)) {
+        mock_default_cmd(cmd);
+    }
+}
+
+// Byte received by the module
+static void mock_rx(char c) {
+    switch (mock.state) {
+        case MOCK_RX_LINE:
+            if (mock.line_len < MOCK_LINE_LENGTH) {
+                mock.line[mock.line_len++] = c;
+                mock.line[mock.line_len] = '\0';
+            }
+            if (c == '\n') {
+                mock_line();
+                mock.line_len = 0;
+            }
+            break;
+        case MOCK_RX_DATA:
+            mock.data[mock.data_len++] = c;
+            if (mock.data_len == mock.data_expected) {
+                mock_data_done();
+            }
+            break;
+        case MOCK_RX_DATA_EX:
+            // \0 ends the data, \\ is a backslash
+            if (mock.data_escape) {
+                mock.data_escape = false;
+                if (c == '0') {
+                    mock_data_done();
+                    break;
+                }
+                mock.data[mock.data_len++] = c;
+            } else if (c == '\\') {
+                mock.data_escape = true;
+                break;
+            } else {
+                mock.data[mock.data_len++] = c;
+            }
+            if (mock.data_len == mock.data_expected) {
+                mock_data_done();
+            }
+            break;
+    }
+}
+
+// Time
+
+uint64_t time_us_64(void) {
+    return mock.now_ns / 1000;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t) time_us_64();
+}
+
+absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t) (t / 1000);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return time_us_64() + (uint64_t) ms * 1000;
+}
+
+bool time_reached(absolute_time_t t) {
+    return time_us_64() >= t;
+}
+
+void sleep_us(uint64_t us) {
+    mock.now_ns += us * 1000;
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t) ms * 1000);
+}
+
+// UART
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+    mock.byte_ns = 10000000000ull / baudrate;
+    return baudrate;
+}
+
+void uart_deinit(uart_inst_t *uart) {
+}
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate) {
+    return uart_init(uart, baudrate);
+}
+
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity) {
+}
+
+void uart_set_hw_flow(uart_inst_t *uart, bool cts, bool rts) {
+}
+
+void uart_set_translate_crlf(uart_inst_t *uart, bool translate) {
+    mock.translate_crlf = translate;
+}
+
+bool uart_is_writable(uart_inst_t *uart) {
+    return true;
+}
+
+void uart_putc_raw(uart_inst_t *uart, char c) {
+    mock.now_ns += mock.byte_ns;
+    mock.rx_bytes++;
+    mock_rx(c);
+}
+
+void uart_putc(uart_inst_t *uart, char c) {
+    if (mock.translate_crlf && c == '\n') {
+        uart_putc_raw(uart, '\r');
+    }
+    uart_putc_raw(uart, c);
+}
+
+bool uart_is_readable_within_us(uart_inst_t *uart, uint32_t us) {
+    uint64_t deadline_ns = mock.now_ns + (uint64_t) us * 1000;
+
+    while (mock.fifo_len == 0) {
+        if (!mock_wire_next(deadline_ns)) {
+            mock.now_ns = deadline_ns;
+            return false;
+        }
+    }
+
+    mock_byte_t *byte = &mock.fifo[mock.fifo_head];
+    if (byte->at_ns > deadline_ns) {
+        mock.now_ns = deadline_ns;
+        return false;
+    }
+    if (byte->at_ns > mock.now_ns) {
+        mock.now_ns = byte->at_ns;
+    }
+    return true;
+}
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart) {
+    // Reading the data register pops the received byte
+    mock.hw.dr = 0;
+    if (mock.fifo_len > 0 && mock.fifo[mock.fifo_head].at_ns <= mock.now_ns) {
+        mock.hw.dr = mock.fifo[mock.fifo_head].dr;
+        mock.fifo_head = (mock.fifo_head + 1) % MOCK_FIFO_LENGTH;
+        mock.fifo_len--;
+    }
+    return &mock.hw;
+}
+
+// GPIO
+
+void gpio_set_function(uint gpio, gpio_function_t fn) {
+}
+
+void gpio_deinit(uint gpio) {
+}
+
+// Synchronization (single threaded host, the locks are never contended)
+
+static spin_lock_t mock_spin_locks[32];
+
+spin_lock_t *spin_lock_instance(uint lock_num) {
+    return &mock_spin_locks[lock_num % 32];
+}
+
+uint next_striped_spin_lock_num(void) {
+    static uint next = 16;
+    uint lock_num = next;
+    next = next == 23 ? 16 : next + 1;
+    return lock_num;
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    *lock = 1;
+    return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    *lock = 0;
+}
+
+void lock_init(lock_core_t *core, uint lock_num) {
+    core->spin_lock = spin_lock_instance(lock_num);
+}
+
+lock_owner_id_t lock_get_caller_owner_id(void) {
+    return mock.owner;
+}
+
+void lock_internal_spin_unlock_with_notify(lock_core_t *lock, uint32_t save) {
+    spin_unlock(lock->spin_lock, save);
+}
+
+bool lock_internal_spin_unlock_with_best_effort_wait_or_timeout(lock_core_t *lock, uint32_t save,
+                                                                absolute_time_t until) {
+    spin_unlock(lock->spin_lock, save);
+
+    // Another task runs while the caller waits (once), then the caller checks the lock again
+    if (mock.wait_task != NULL) {
+        mock_task_t task = mock.wait_task;
+        lock_owner_id_t owner = mock.owner;
+        mock.wait_task = NULL;
+        task(mock.wait_ctx);
+        mock.owner = owner;
+        return true;
+    }
+
+    if (!time_reached(until)) {
+        mock.now_ns = until * 1000;
+    }
+    return true;
+}
+
+uint __get_current_exception(void) {
+    return mock.exception;
+}
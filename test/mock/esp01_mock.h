@@ -0,0 +1,134 @@
+#ifndef _ESP01_MOCK_H
+#define _ESP01_MOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/lock_core.h"
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOCK_LINKS 5
+#define MOCK_LINE_LENGTH 512
+#define MOCK_MESSAGES 256
+#define MOCK_FIFO_LENGTH 32768
+
+// Fail the test with the location of the check
+#define MOCK_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+/*!
+ * Command handler, called with each command line received by the module (without its line ending), after the echo.
+ * The replies are scheduled with mock_reply.
+ *
+ * @param cmd Command line
+ * @param ctx User context
+ * @return True if the command was handled, false to fall back to the default behaviour
+ */
+typedef bool (*mock_cmd_handler_t)(const char *cmd, void *ctx);
+
+/*!
+ * Peer handler, called when a segment sent by the module reaches the remote peer. The peer answers with mock_ipd.
+ *
+ * @param link_id Link ID (0 in single connection mode)
+ * @param data Segment data
+ * @param len Segment length
+ * @param at_us Arrival time of the segment
+ * @param ctx User context
+ * @return True if the peer answered (the ACK is sent along with the answer), false if the ACK is delayed
+ */
+typedef bool (*mock_peer_handler_t)(int link_id, const char *data, size_t len, uint64_t at_us, void *ctx);
+
+/*!
+ * Task run by another owner while the caller waits for a lock. It sets its owner ID with mock_set_owner, the ID of
+ * the caller is restored when it returns.
+ *
+ * @param ctx User context
+ */
+typedef void (*mock_task_t)(void *ctx);
+
+// Module model
+struct mock_config {
+    uint baud_rate;
+    uint32_t cmd_latency_us;    // Processing time of a command
+    uint32_t send_latency_us;   // Time to hand the data of AT+CIPSEND to the TCP stack
+    uint32_t net_delay_us;      // One way network delay
+    uint32_t ack_delay_us;      // Delayed ACK of the peer
+    size_t mss;
+    int free_heap;              // AT+SYSRAM answer (ESP01_UNDEFINED if the command is unknown)
+} typedef mock_config_t;
+
+// Link state kept by the module
+struct mock_link {
+    bool open;
+    int so_linger;
+    int tcp_nodelay;
+    int so_sndtimeo;
+    int keep_alive;
+    uint64_t unacked_ns;        // Time at which the data in flight is acknowledged
+    uint segments;
+    size_t tx_bytes;
+} typedef mock_link_t;
+
+// Reset the clock and the module (NULL for the default model)
+void mock_reset(const mock_config_t *config);
+
+mock_config_t mock_default_config(void);
+
+uint64_t mock_now_us(void);
+
+void mock_set_cmd_handler(mock_cmd_handler_t handler, void *ctx);
+
+void mock_set_peer_handler(mock_peer_handler_t handler, void *ctx);
+
+// Schedule module output at an absolute time
+void mock_send_at(uint64_t at_us, const char *data, size_t len);
+
+// Schedule module output after a delay
+void mock_send(uint32_t delay_us, const char *str);
+
+// Answer the current command after a delay (the module is busy until then)
+void mock_reply(uint32_t delay_us, const char *str);
+
+// Schedule socket data (+IPD) at an absolute time
+void mock_ipd_at(uint64_t at_us, int link_id, const char *data, size_t len);
+
+// Corrupt the next byte sent by the module (framing error)
+void mock_framing_error(void);
+
+// Number of command lines received starting with a prefix
+uint mock_command_count(const char *prefix);
+
+// Last command line received
+const char *mock_last_command(void);
+
+mock_link_t *mock_link(int link_id);
+
+void mock_set_multiple(bool multiple);
+
+void mock_set_exception(uint exception);
+
+// Owner ID of the running task (0 after a reset)
+void mock_set_owner(lock_owner_id_t owner);
+
+// Run a task the next time a lock is waited for (without a task, the wait runs until the timeout)
+void mock_set_wait_task(mock_task_t task, void *ctx);
+
+// Bytes received by the module on the wire
+size_t mock_rx_bytes(void);
+
+// Bytes put on the wire by the module
+size_t mock_tx_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum gpio_function {
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_NULL = 0x1f,
+} typedef gpio_function_t;
+
+void gpio_set_function(uint gpio, gpio_function_t fn);
+
+void gpio_deinit(uint gpio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
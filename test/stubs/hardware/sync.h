@@ -0,0 +1,24 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile uint32_t spin_lock_t;
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+
+uint next_striped_spin_lock_num(void);
+
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _HARDWARE_UART_H
+#define _HARDWARE_UART_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UART_UARTDR_OE_BITS 0x00000800
+#define UART_UARTDR_BE_BITS 0x00000400
+#define UART_UARTDR_PE_BITS 0x00000200
+#define UART_UARTDR_FE_BITS 0x00000100
+#define UART_UARTDR_DATA_BITS 0x000000ff
+
+// Data register of the host mock (reading it pops the next received byte)
+typedef struct uart_hw {
+    uint32_t dr;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+
+extern uart_inst_t *const uart0;
+extern uart_inst_t *const uart1;
+
+enum uart_parity {
+    UART_PARITY_NONE,
+    UART_PARITY_EVEN,
+    UART_PARITY_ODD,
+} typedef uart_parity_t;
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+
+void uart_deinit(uart_inst_t *uart);
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate);
+
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity);
+
+void uart_set_hw_flow(uart_inst_t *uart, bool cts, bool rts);
+
+void uart_set_translate_crlf(uart_inst_t *uart, bool translate);
+
+bool uart_is_writable(uart_inst_t *uart);
+
+void uart_putc_raw(uart_inst_t *uart, char c);
+
+void uart_putc(uart_inst_t *uart, char c);
+
+bool uart_is_readable_within_us(uart_inst_t *uart, uint32_t us);
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _PICO_LOCK_CORE_H
+#define _PICO_LOCK_CORE_H
+
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int8_t lock_owner_id_t;
+
+#define LOCK_INVALID_OWNER_ID ((lock_owner_id_t) -1)
+
+struct lock_core {
+    spin_lock_t *spin_lock;
+} typedef lock_core_t;
+
+void lock_init(lock_core_t *core, uint lock_num);
+
+lock_owner_id_t lock_get_caller_owner_id(void);
+
+void lock_internal_spin_unlock_with_notify(lock_core_t *lock, uint32_t save);
+
+// Single threaded host: the wait runs the task set with mock_set_wait_task, or runs until the timeout
+bool lock_internal_spin_unlock_with_best_effort_wait_or_timeout(lock_core_t *lock, uint32_t save,
+                                                                absolute_time_t until);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _PICO_MALLOC_H
+#define _PICO_MALLOC_H
+
+#include <stdlib.h>
+
+#endif
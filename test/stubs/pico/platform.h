@@ -0,0 +1,17 @@
+#ifndef _PICO_PLATFORM_H
+#define _PICO_PLATFORM_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exception number set by the host mock (0 in thread mode)
+uint __get_current_exception(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+#endif
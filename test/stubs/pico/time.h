@@ -0,0 +1,31 @@
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Virtual clock of the host mock (it only moves when the driver waits or transmits)
+uint64_t time_us_64(void);
+
+uint32_t time_us_32(void);
+
+absolute_time_t get_absolute_time(void);
+
+uint32_t to_ms_since_boot(absolute_time_t t);
+
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+
+bool time_reached(absolute_time_t t);
+
+void sleep_ms(uint32_t ms);
+
+void sleep_us(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+static uint32_t latency_us;
+
+static bool handler(const char *cmd, void *ctx) {
+    if (strncmp(cmd, "AT+PING=", 8) == 0) {
+        char rsp[64];
+        sprintf(rsp, "+PING:%u\r\n\r\nOK\r\n", latency_us / 1000);
+        mock_reply(latency_us, rsp);
+        return true;
+    }
+    if (strcmp(cmd, "AT+CWMODE?") == 0) {
+        mock_reply(latency_us, "+CWMODE:1\r\n\r\nOK\r\n");
+        return true;
+    }
+    return false;
+}
+
+// The latency of a ping depends on the host, a slow one keeps the caller timeout
+static void test_network_command(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    uint rtt_ms;
+    latency_us = 5000;
+    for (int i = 0; i < 2 * ESP01_ADAPTIVE_MIN_SAMPLES; i++) {
+        MOCK_CHECK(esp01_ping(inst, "192.168.4.1", &rtt_ms));
+    }
+
+    latency_us = 2000000;
+    MOCK_CHECK(esp01_ping(inst, "8.8.8.8", &rtt_ms) && rtt_ms == 2000);
+
+    esp01_latency_estimate_t estimate;
+    MOCK_CHECK(!esp01_get_latency_estimate(inst, AT_SET, AT_IP_PING, &estimate));
+
+    esp01_deinit(inst);
+}
+
+// A local command adapts its timeout, never below the floor
+static void test_local_command(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    esp01_wifi_mode_t mode;
+    latency_us = 2000;
+    for (int i = 0; i < 2 * ESP01_ADAPTIVE_MIN_SAMPLES; i++) {
+        MOCK_CHECK(esp01_get_wifi_mode(inst, &mode));
+    }
+
+    esp01_latency_estimate_t estimate;
+    MOCK_CHECK(esp01_get_latency_estimate(inst, AT_QUERY, AT_WIFI_MODE, &estimate));
+    MOCK_CHECK(estimate.samples == 2 * ESP01_ADAPTIVE_MIN_SAMPLES);
+    MOCK_CHECK(estimate.srtt_us < 10000 && estimate.timeout_ms == ESP01_ADAPTIVE_MIN_TIMEOUT);
+
+    // Within the floor
+    latency_us = 300000;
+    MOCK_CHECK(esp01_get_wifi_mode(inst, &mode));
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_network_command();
+    test_local_command();
+    printf("test_adaptive: ok\n");
+    return 0;
+}
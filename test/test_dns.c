@@ -0,0 +1,115 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Names known by the device resolve to 10.0.0.<index + 1>, "slow.example" is never answered, others fail
+static const char *hosts[] = {"a.example", "b.example", "c.example", "d.example", "e.example"};
+
+static bool handler(const char *cmd, void *ctx) {
+    if (strncmp(cmd, "AT+CIPDOMAIN=", 13) != 0) {
+        return false;
+    }
+
+    for (uint i = 0; i < sizeof(hosts) / sizeof(hosts[0]); i++) {
+        char expected[ESP01_HOST_LENGTH + 16];
+        sprintf(expected, "AT+CIPDOMAIN=\"%s\"", hosts[i]);
+        if (strcmp(cmd, expected) == 0) {
+            char rsp[64];
+            sprintf(rsp, "+CIPDOMAIN:\"10.0.0.%u\"\r\n\r\nOK\r\n", i + 1);
+            mock_reply(mock_default_config().cmd_latency_us, rsp);
+            return true;
+        }
+    }
+    if (strcmp(cmd, "AT+CIPDOMAIN=\"slow.example\"") == 0) {
+        return true;
+    }
+    mock_reply(mock_default_config().cmd_latency_us, "\r\nERROR\r\n");
+    return true;
+}
+
+static esp01_inst_t *start(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_set_recovery(inst, 0, ESP01_RECOVERY_BACKOFF);
+    return inst;
+}
+
+// A resolved name is served from the cache until it expires
+static void test_hit_and_expiry(void) {
+    esp01_inst_t *inst = start();
+    char ip[ESP01_IP_LENGTH + 1];
+
+    MOCK_CHECK(esp01_dns_lookup(inst, "a.example", ip) && strcmp(ip, "10.0.0.1") == 0);
+    MOCK_CHECK(esp01_dns_lookup(inst, "a.example", ip) && strcmp(ip, "10.0.0.1") == 0);
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=") == 1);
+    MOCK_CHECK(esp01_get_dns_cache_stats(inst).hits == 1 && esp01_get_dns_cache_stats(inst).misses == 1);
+
+    sleep_ms(ESP01_DNS_DEFAULT_TTL);
+    MOCK_CHECK(esp01_dns_lookup(inst, "a.example", ip));
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=") == 2 && esp01_get_dns_cache_stats(inst).misses == 2);
+
+    // Literal addresses don't go to the device, and must fit in the result
+    MOCK_CHECK(esp01_dns_lookup(inst, "192.168.4.1", ip) && strcmp(ip, "192.168.4.1") == 0);
+    MOCK_CHECK(!esp01_dns_lookup(inst, "1111:2222:3333:4444:5555:6666:7777:8888:9999", ip));
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=") == 2);
+
+    esp01_deinit(inst);
+}
+
+// A name the device can't resolve is cached for the negative time to live, a timeout isn't cached
+static void test_negative_entry(void) {
+    esp01_inst_t *inst = start();
+    char ip[ESP01_IP_LENGTH + 1];
+
+    MOCK_CHECK(!esp01_dns_lookup(inst, "unknown.example", ip));
+    MOCK_CHECK(!esp01_dns_lookup(inst, "unknown.example", ip));
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=\"unknown") == 1);
+    MOCK_CHECK(esp01_get_dns_cache_stats(inst).negative_hits == 1);
+
+    sleep_ms(ESP01_DNS_DEFAULT_NEGATIVE_TTL);
+    MOCK_CHECK(!esp01_dns_lookup(inst, "unknown.example", ip));
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=\"unknown") == 2);
+
+    MOCK_CHECK(!esp01_dns_lookup(inst, "slow.example", ip));
+    MOCK_CHECK(!esp01_dns_lookup(inst, "slow.example", ip));
+    MOCK_CHECK(mock_command_count("AT+CIPDOMAIN=\"slow") == 2);
+    MOCK_CHECK(esp01_get_dns_cache_stats(inst).negative_hits == 1);
+
+    esp01_deinit(inst);
+}
+
+// A full cache evicts the least recently used entry
+static void test_eviction(void) {
+    esp01_inst_t *inst = start();
+    char ip[ESP01_IP_LENGTH + 1];
+
+    for (uint i = 0; i < ESP01_DNS_CACHE_SIZE; i++) {
+        MOCK_CHECK(esp01_dns_lookup(inst, hosts[i], ip));
+        sleep_ms(10);
+    }
+    MOCK_CHECK(esp01_dns_lookup(inst, hosts[0], ip));
+    sleep_ms(10);
+
+    MOCK_CHECK(esp01_dns_lookup(inst, hosts[ESP01_DNS_CACHE_SIZE], ip) && strcmp(ip, "10.0.0.5") == 0);
+    MOCK_CHECK(esp01_get_dns_cache_stats(inst).evictions == 1);
+
+    // The first host was used again, the second one was evicted
+    uint commands = mock_command_count("AT+CIPDOMAIN=");
+    MOCK_CHECK(esp01_dns_lookup(inst, hosts[0], ip) && mock_command_count("AT+CIPDOMAIN=") == commands);
+    MOCK_CHECK(esp01_dns_lookup(inst, hosts[1], ip) && mock_command_count("AT+CIPDOMAIN=") == commands + 1);
+
+    MOCK_CHECK(esp01_flush_dns_cache(inst));
+    MOCK_CHECK(esp01_dns_lookup(inst, hosts[0], ip) && mock_command_count("AT+CIPDOMAIN=") == commands + 2);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_hit_and_expiry();
+    test_negative_entry();
+    test_eviction();
+    printf("test_dns: ok\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Corrupt the AT+SYSRAM responses
+static bool corrupt_sysram;
+
+static bool handler(const char *cmd, void *ctx) {
+    if (corrupt_sysram && strcmp(cmd, "AT+SYSRAM?") == 0) {
+        mock_framing_error();
+        mock_reply(mock_default_config().cmd_latency_us, "+SYSRAM:6000,3000\r\n\r\nOK\r\n");
+        return true;
+    }
+    return false;
+}
+
+// The device heap is between the watermarks, where small sends may be coalesced
+static esp01_inst_t *start(int free_heap) {
+    mock_config_t config = mock_default_config();
+    config.free_heap = free_heap;
+    mock_reset(&config);
+    mock_set_cmd_handler(handler, NULL);
+    mock_link(0)->open = true;
+    corrupt_sysram = false;
+    return esp01_init(uart0, 115200, 0, 1);
+}
+
+// Each send is written when called unless coalescing is enabled
+static void test_coalescing_opt_in(void) {
+    esp01_inst_t *inst = start(6000);
+
+    MOCK_CHECK(esp01_ip_send(inst, 0, "abc", 3));
+    MOCK_CHECK(esp01_ip_send(inst, 0, "def", 3));
+    MOCK_CHECK(mock_command_count("AT+CIPSEND=") == 2);
+    MOCK_CHECK(esp01_get_flow_stats(inst).coalesced == 0);
+
+    esp01_set_flow_control(inst, true, true, ESP01_FLOW_LOW_WATERMARK, ESP01_FLOW_HIGH_WATERMARK,
+                           ESP01_FLOW_SAMPLE_INTERVAL);
+    MOCK_CHECK(esp01_ip_send(inst, 0, "abc", 3));
+    MOCK_CHECK(esp01_ip_send(inst, 0, "def", 3));
+    MOCK_CHECK(mock_command_count("AT+CIPSEND=") == 2);
+    MOCK_CHECK(esp01_ip_flush(inst));
+    MOCK_CHECK(mock_command_count("AT+CIPSEND=") == 3 && mock_link(0)->tx_bytes == 12);
+    MOCK_CHECK(esp01_get_flow_stats(inst).coalesced == 1);
+
+    esp01_deinit(inst);
+}
+
+// Flow control is only turned off when the firmware refuses AT+SYSRAM
+static void test_support(void) {
+    esp01_inst_t *inst = start(6000);
+
+    corrupt_sysram = true;
+    MOCK_CHECK(esp01_ip_send(inst, 0, "abc", 3));
+    MOCK_CHECK(inst->flow.supported && esp01_get_flow_stats(inst).samples == 0);
+
+    corrupt_sysram = false;
+    MOCK_CHECK(esp01_ip_send(inst, 0, "def", 3));
+    MOCK_CHECK(inst->flow.supported && esp01_get_flow_stats(inst).samples == 1);
+    esp01_deinit(inst);
+
+    inst = start(ESP01_UNDEFINED);
+    MOCK_CHECK(esp01_ip_send(inst, 0, "abc", 3));
+    MOCK_CHECK(!inst->flow.supported);
+    MOCK_CHECK(esp01_ip_send(inst, 0, "def", 3));
+    MOCK_CHECK(mock_command_count("AT+SYSRAM?") == 1);
+    esp01_deinit(inst);
+}
+
+// A send waiting for the device heap gives up after its own timeout, not the scheduler one
+static void test_throttle_timeout(void) {
+    esp01_inst_t *inst = start(ESP01_FLOW_LOW_WATERMARK / 2);
+
+    uint64_t start_us = mock_now_us();
+    MOCK_CHECK(!esp01_ip_send(inst, 0, "abc", 3));
+    uint64_t elapsed_us = mock_now_us() - start_us;
+    MOCK_CHECK(elapsed_us >= ESP01_FLOW_THROTTLE_TIMEOUT * 1000);
+    MOCK_CHECK(elapsed_us < (ESP01_FLOW_THROTTLE_TIMEOUT + 2 * ESP01_FLOW_POLL_INTERVAL) * 1000);
+    MOCK_CHECK(elapsed_us < inst->sched.timeout_ms * 1000ull);
+
+    esp01_flow_stats_t stats = esp01_get_flow_stats(inst);
+    MOCK_CHECK(stats.throttles == 1 && stats.throttle_timeouts == 1);
+    MOCK_CHECK(mock_command_count("AT+CIPSEND=") == 0);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_coalescing_opt_in();
+    test_support();
+    test_throttle_timeout();
+    printf("test_flow: ok\n");
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Radio and network seen by the module: "down.example" never answers the pings, the others answer after rtt_ms
+static int rssi;
+static int channel;
+static uint rtt_ms;
+
+static bool handler(const char *cmd, void *ctx) {
+    char rsp[128];
+
+    if (strcmp(cmd, "AT+CWJAP?") == 0) {
+        if (rssi == ESP01_UNDEFINED) {
+            mock_reply(mock_default_config().cmd_latency_us, "\r\nERROR\r\n");
+        } else {
+            sprintf(rsp, "+CWJAP:\"ap\",\"aa:bb:cc:dd:ee:ff\",%d,%d,0,1,3,0,0\r\n\r\nOK\r\n", channel, rssi);
+            mock_reply(mock_default_config().cmd_latency_us, rsp);
+        }
+        return true;
+    }
+
+    if (strncmp(cmd, "AT+PING=", 8) == 0) {
+        if (strcmp(cmd, "AT+PING=\"down.example\"") == 0) {
+            mock_reply(1000000, "+timeout\r\n\r\nERROR\r\n");
+        } else {
+            sprintf(rsp, "+PING:%u\r\n\r\nOK\r\n", rtt_ms);
+            mock_reply(rtt_ms * 1000, rsp);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+static esp01_inst_t *start(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    rssi = -50;
+    channel = 6;
+    rtt_ms = 10;
+    return esp01_init(uart0, 115200, 0, 1);
+}
+
+// A ping is run when due, at most once per call
+static void test_interval(void) {
+    esp01_inst_t *inst = start();
+    esp01_probe_t *probe = esp01_probe_init(inst, 1000);
+    MOCK_CHECK(!esp01_probe_poll(probe));
+    esp01_probe_add_host(probe, "192.168.4.1");
+
+    uint64_t start_us = mock_now_us();
+    MOCK_CHECK(esp01_probe_poll(probe));
+    MOCK_CHECK(!esp01_probe_poll(probe));
+    MOCK_CHECK(mock_command_count("AT+PING=") == 1);
+
+    sleep_us(start_us + 999000 - mock_now_us());
+    MOCK_CHECK(!esp01_probe_poll(probe));
+    sleep_ms(1);
+    MOCK_CHECK(esp01_probe_poll(probe));
+    MOCK_CHECK(mock_command_count("AT+PING=") == 2);
+
+    esp01_probe_sample_t samples[2];
+    MOCK_CHECK(esp01_probe_get_samples(probe, samples, 2) == 2);
+    MOCK_CHECK(samples[1].timestamp_ms - samples[0].timestamp_ms == 1000);
+    MOCK_CHECK(!samples[0].timeout && samples[0].rtt_ms == 10);
+
+    esp01_probe_deinit(probe);
+    esp01_deinit(inst);
+}
+
+// The radio is sampled once per round, the samples taken before the RSSI is known count in the RTT statistics only
+static void test_rssi(void) {
+    esp01_inst_t *inst = start();
+    esp01_probe_t *probe = esp01_probe_init(inst, 0);
+    esp01_probe_add_host(probe, "192.168.4.1");
+    esp01_probe_add_host(probe, "192.168.4.2");
+
+    rssi = ESP01_UNDEFINED;
+    rtt_ms = 500;
+    MOCK_CHECK(esp01_probe_poll(probe) && esp01_probe_poll(probe));
+
+    // RTT and RSSI perfectly anti-correlated over the rounds with a RSSI
+    for (int i = 1; i <= 3; i++) {
+        rssi = -40 - 10 * i;
+        rtt_ms = 10 * i;
+        MOCK_CHECK(esp01_probe_poll(probe) && esp01_probe_poll(probe));
+    }
+    MOCK_CHECK(mock_command_count("AT+CWJAP?") == 4 && mock_command_count("AT+PING=") == 8);
+
+    esp01_probe_stats_t stats;
+    for (uint host = 0; host < 2; host++) {
+        MOCK_CHECK(esp01_probe_get_stats(probe, host, ESP01_UNDEFINED, &stats));
+        MOCK_CHECK(stats.count == 4 && stats.rssi_count == 3 && stats.timeouts == 0);
+        MOCK_CHECK(stats.avg_ms == 140 && stats.min_ms == 10 && stats.max_ms == 500);
+        MOCK_CHECK(stats.avg_rssi == -60);
+        MOCK_CHECK(stats.rtt_rssi_correlation < -0.999f);
+    }
+
+    // Channel filter
+    channel = 11;
+    MOCK_CHECK(esp01_probe_poll(probe));
+    MOCK_CHECK(esp01_probe_get_stats(probe, 0, 11, &stats) && stats.count == 1);
+    MOCK_CHECK(!esp01_probe_get_stats(probe, 1, 11, &stats));
+
+    esp01_probe_deinit(probe);
+    esp01_deinit(inst);
+}
+
+// Failed pings are counted apart from the RTT statistics
+static void test_failures(void) {
+    esp01_inst_t *inst = start();
+    esp01_probe_t *probe = esp01_probe_init(inst, 0);
+    esp01_probe_add_host(probe, "down.example");
+    esp01_probe_add_host(probe, "192.168.4.1");
+
+    for (int i = 0; i < 6; i++) {
+        MOCK_CHECK(esp01_probe_poll(probe));
+    }
+
+    esp01_probe_stats_t stats;
+    MOCK_CHECK(esp01_probe_get_stats(probe, 0, ESP01_UNDEFINED, &stats));
+    MOCK_CHECK(stats.count == 0 && stats.timeouts == 3);
+    MOCK_CHECK(esp01_probe_get_stats(probe, 1, ESP01_UNDEFINED, &stats));
+    MOCK_CHECK(stats.count == 3 && stats.timeouts == 0 && stats.avg_ms == 10);
+
+    esp01_probe_sample_t samples[6];
+    MOCK_CHECK(esp01_probe_get_samples(probe, samples, 6) == 6);
+    MOCK_CHECK(samples[0].host == 0 && samples[0].timeout && samples[1].host == 1 && !samples[1].timeout);
+
+    esp01_probe_deinit(probe);
+    esp01_deinit(inst);
+}
+
+// The ring keeps the last ESP01_PROBE_RING_LENGTH samples
+static void test_wrap_around(void) {
+    esp01_inst_t *inst = start();
+    esp01_probe_t *probe = esp01_probe_init(inst, 0);
+    esp01_probe_add_host(probe, "192.168.4.1");
+
+    uint total = ESP01_PROBE_RING_LENGTH + 10;
+    for (uint i = 1; i <= total; i++) {
+        rtt_ms = i;
+        MOCK_CHECK(esp01_probe_poll(probe));
+    }
+
+    esp01_probe_sample_t samples[ESP01_PROBE_RING_LENGTH + 1];
+    MOCK_CHECK(esp01_probe_get_samples(probe, samples, ESP01_PROBE_RING_LENGTH + 1) == ESP01_PROBE_RING_LENGTH);
+    MOCK_CHECK(samples[0].rtt_ms == 11 && samples[ESP01_PROBE_RING_LENGTH - 1].rtt_ms == total);
+    MOCK_CHECK(esp01_probe_get_samples(probe, samples, 2) == 2 && samples[1].rtt_ms == total);
+
+    esp01_probe_stats_t stats;
+    MOCK_CHECK(esp01_probe_get_stats(probe, 0, ESP01_UNDEFINED, &stats));
+    MOCK_CHECK(stats.count == ESP01_PROBE_RING_LENGTH && stats.min_ms == 11 && stats.max_ms == total);
+
+    esp01_probe_deinit(probe);
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_interval();
+    test_rssi();
+    test_failures();
+    test_wrap_around();
+    printf("test_probe: ok\n");
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Commands the module doesn't answer in time
+static uint32_t close_latency_us;
+
+static bool handler(const char *cmd, void *ctx) {
+    if (strcmp(cmd, "AT+CIPCLOSE") == 0) {
+        mock_reply(close_latency_us, "CLOSED\r\n\r\nOK\r\n");
+        return true;
+    }
+    return strncmp(cmd, "AT+UART_CUR=", 12) == 0 || strncmp(cmd, "AT+CWMODE=", 10) == 0;
+}
+
+static esp01_inst_t *start(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    return esp01_init(uart0, 115200, 0, 1);
+}
+
+// The late OK of a command that timed out isn't taken for the response of the next one
+static void test_late_response(void) {
+    esp01_inst_t *inst = start();
+
+    close_latency_us = 1500000;
+    MOCK_CHECK(!esp01_ip_close(inst, ESP01_UNDEFINED));
+    MOCK_CHECK(mock_command_count("AT+CIPCLOSE") == 1);
+    MOCK_CHECK(esp01_get_recovery_stats(inst).resyncs == 1);
+
+    // The module answers ERROR to AT+CWMODE?
+    sleep_ms(600);
+    esp01_wifi_mode_t mode;
+    MOCK_CHECK(!esp01_get_wifi_mode(inst, &mode) && esp01_get_last_status(inst) == ESP01_RSP_ERROR);
+    MOCK_CHECK(esp01_test(inst));
+
+    esp01_deinit(inst);
+}
+
+// Corrupted bytes received before the echo don't belong to the response
+static void test_stale_framing_error(void) {
+    esp01_inst_t *inst = start();
+
+    mock_framing_error();
+    mock_send(0, "x\r\n");
+    MOCK_CHECK(esp01_test(inst));
+    MOCK_CHECK(esp01_get_recovery_stats(inst).framing == 0);
+
+    esp01_deinit(inst);
+}
+
+// Only the commands known to be idempotent are sent again
+static void test_retries(void) {
+    esp01_inst_t *inst = start();
+
+    esp01_uart_settings_t uart_set = {115200, 8, 1, UART_PARITY_NONE, false, false};
+    MOCK_CHECK(!esp01_set_uart_settings(inst, uart_set, true));
+    MOCK_CHECK(mock_command_count("AT+UART_CUR=") == 1);
+
+    MOCK_CHECK(!esp01_set_wifi_mode(inst, ESP01_WIFI_STATION));
+    MOCK_CHECK(mock_command_count("AT+CWMODE=") == 1 + ESP01_RECOVERY_RETRIES);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_late_response();
+    test_stale_framing_error();
+    test_retries();
+    printf("test_recovery: ok\n");
+    return 0;
+}
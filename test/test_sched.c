@@ -0,0 +1,137 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// An out of range priority is refused instead of indexing the statistics
+static void test_invalid_priority(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    MOCK_CHECK(!esp01_lock(inst, (esp01_priority_t) ESP01_PRIORITIES, 0));
+    MOCK_CHECK(!esp01_lock(inst, (esp01_priority_t) -1, 0));
+    MOCK_CHECK(inst->sched.owner == LOCK_INVALID_OWNER_ID);
+
+    MOCK_CHECK(esp01_lock(inst, ESP01_PRIORITY_HIGH, 0));
+    MOCK_CHECK(esp01_lock(inst, ESP01_PRIORITY_LOW, 0));
+    esp01_unlock(inst);
+    esp01_unlock(inst);
+    MOCK_CHECK(inst->sched.owner == LOCK_INVALID_OWNER_ID);
+    MOCK_CHECK(esp01_get_sched_stats(inst).acquired[ESP01_PRIORITY_HIGH] == 1);
+
+    esp01_deinit(inst);
+}
+
+// Unlocking an instance that isn't locked asserts (and leaves it unlocked without assertions)
+static void test_unbalanced_unlock(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+#ifdef NDEBUG
+    esp01_unlock(inst);
+    MOCK_CHECK(inst->sched.depth == 0 && inst->sched.owner == LOCK_INVALID_OWNER_ID);
+#else
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        fclose(stderr);
+        esp01_unlock(inst);
+        _exit(0);
+    }
+    int status;
+    MOCK_CHECK(waitpid(pid, &status, 0) == pid);
+    MOCK_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+#endif
+
+    esp01_deinit(inst);
+}
+
+// Tasks contending for the instance: the holder, a housekeeping task and an urgent send
+#define HOLDER 1
+#define HOUSEKEEPING 2
+#define URGENT 3
+
+static esp01_inst_t *contended;
+static char grants[4];
+static uint grant_count;
+
+// The holder releases the instance after 5 ms
+static void release_task(void *ctx) {
+    mock_set_owner(HOLDER);
+    sleep_ms(5);
+    esp01_unlock(contended);
+}
+
+// The urgent send is queued after the housekeeping task and uses the instance for 2 ms
+static void urgent_task(void *ctx) {
+    mock_set_owner(URGENT);
+    mock_set_wait_task(release_task, NULL);
+    MOCK_CHECK(esp01_lock(contended, ESP01_PRIORITY_HIGH, 1000));
+    grants[grant_count++] = 'U';
+    sleep_ms(2);
+    esp01_unlock(contended);
+}
+
+// A higher priority waiter is granted the instance first, whatever the arrival order
+static void test_contention(void) {
+    mock_reset(NULL);
+    contended = esp01_init(uart0, 115200, 0, 1);
+    grant_count = 0;
+    esp01_sched_stats_t before = esp01_get_sched_stats(contended);
+
+    mock_set_owner(HOLDER);
+    MOCK_CHECK(esp01_lock(contended, ESP01_PRIORITY_NORMAL, 0));
+
+    mock_set_owner(HOUSEKEEPING);
+    mock_set_wait_task(urgent_task, NULL);
+    MOCK_CHECK(esp01_lock(contended, ESP01_PRIORITY_LOW, 1000));
+    grants[grant_count++] = 'H';
+    esp01_unlock(contended);
+
+    MOCK_CHECK(grant_count == 2 && grants[0] == 'U' && grants[1] == 'H');
+
+    esp01_sched_stats_t stats = esp01_get_sched_stats(contended);
+    MOCK_CHECK(stats.acquired[ESP01_PRIORITY_HIGH] == before.acquired[ESP01_PRIORITY_HIGH] + 1);
+    MOCK_CHECK(stats.acquired[ESP01_PRIORITY_LOW] == before.acquired[ESP01_PRIORITY_LOW] + 1);
+    MOCK_CHECK(stats.max_wait_us[ESP01_PRIORITY_HIGH] == 5000);
+    MOCK_CHECK(stats.max_wait_us[ESP01_PRIORITY_LOW] == 7000);
+    MOCK_CHECK(stats.total_wait_us[ESP01_PRIORITY_LOW] - before.total_wait_us[ESP01_PRIORITY_LOW] == 7000);
+    MOCK_CHECK(stats.timeouts == 0 && contended->sched.owner == LOCK_INVALID_OWNER_ID);
+
+    mock_set_owner(0);
+    esp01_deinit(contended);
+}
+
+// Only the waits that ran out are timeouts, not the tries of a busy instance
+static void test_timeouts(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    mock_set_owner(HOLDER);
+    MOCK_CHECK(esp01_lock(inst, ESP01_PRIORITY_NORMAL, 0));
+
+    mock_set_owner(URGENT);
+    MOCK_CHECK(!esp01_lock(inst, ESP01_PRIORITY_HIGH, 0));
+    MOCK_CHECK(esp01_get_sched_stats(inst).timeouts == 0);
+
+    uint64_t start_us = mock_now_us();
+    MOCK_CHECK(!esp01_lock(inst, ESP01_PRIORITY_HIGH, 10));
+    MOCK_CHECK(mock_now_us() - start_us == 10000);
+    MOCK_CHECK(esp01_get_sched_stats(inst).timeouts == 1);
+
+    mock_set_owner(HOLDER);
+    esp01_unlock(inst);
+    mock_set_owner(0);
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_invalid_priority();
+    test_unbalanced_unlock();
+    test_contention();
+    test_timeouts();
+    printf("test_sched: ok\n");
+    return 0;
+}
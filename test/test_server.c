@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Server events in dispatch order
+static char log_text[1024];
+
+static void log_event(const char *event, esp01_server_conn_t *conn, const char *data, size_t len) {
+    size_t n = strlen(log_text);
+    n += sprintf(log_text + n, "%s%d", event, conn->link_id);
+    if (data != NULL) {
+        n += sprintf(log_text + n, ":%.*s", (int) len, data);
+    }
+    strcpy(log_text + n, " ");
+}
+
+static void on_connect(esp01_server_t *server, esp01_server_conn_t *conn, void *ctx) {
+    log_event("connect", conn, NULL, 0);
+}
+
+// Consume whole lines only
+static size_t on_data(esp01_server_t *server, esp01_server_conn_t *conn, const char *data, size_t len, void *ctx) {
+    size_t consumed = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\n') {
+            log_event("data", conn, data + consumed, i - consumed);
+            consumed = i + 1;
+        }
+    }
+    return consumed;
+}
+
+static void on_close(esp01_server_t *server, esp01_server_conn_t *conn, void *ctx) {
+    log_event("close", conn, NULL, 0);
+}
+
+static void ipd(uint32_t delay_us, int link_id, const char *str) {
+    mock_ipd_at(mock_now_us() + delay_us, link_id, str, strlen(str));
+}
+
+static esp01_server_t *start(esp01_inst_t **inst) {
+    mock_reset(NULL);
+    *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_server_t *server = esp01_server_init(*inst, 80, 3, 10);
+    MOCK_CHECK(server != NULL);
+    esp01_server_set_handlers(server, on_connect, on_data, on_close, NULL);
+    log_text[0] = '\0';
+    return server;
+}
+
+// A connection opened, fed and closed between two polls is dispatched in order and doesn't stay active
+static void test_short_connection(void) {
+    esp01_inst_t *inst;
+    esp01_server_t *server = start(&inst);
+
+    mock_send(0, "0,CONNECT\r\n");
+    ipd(100, 0, "hello\n");
+    mock_send(200, "0,CLOSED\r\n");
+    esp01_server_poll(server, 50);
+
+    MOCK_CHECK(strcmp(log_text, "connect0 data0:hello close0 ") == 0);
+    MOCK_CHECK(!server->conns[0].active);
+    MOCK_CHECK(server->stats.accepted == 1 && server->stats.closed == 1 && server->stats.dropped_bytes == 0);
+
+    esp01_server_deinit(server);
+    esp01_deinit(inst);
+}
+
+// Two connections of the same link between two polls, the unconsumed data of the first one is dropped at its close
+static void test_link_reuse(void) {
+    esp01_inst_t *inst;
+    esp01_server_t *server = start(&inst);
+
+    mock_send(0, "1,CONNECT\r\n");
+    esp01_server_poll(server, 10);
+    log_text[0] = '\0';
+
+    ipd(100, 1, "first\npartial");
+    mock_send(200, "1,CLOSED\r\n");
+    mock_send(300, "1,CONNECT\r\n");
+    ipd(400, 1, "second\n");
+    esp01_server_poll(server, 50);
+
+    MOCK_CHECK(strcmp(log_text, "data1:first close1 connect1 data1:second ") == 0);
+    MOCK_CHECK(server->conns[1].active);
+    MOCK_CHECK(server->stats.dropped_bytes == strlen("partial"));
+
+    esp01_server_deinit(server);
+    esp01_deinit(inst);
+}
+
+// Connections that don't fit in the event queue are counted as missed, the last one is still dispatched
+static void test_event_queue_full(void) {
+    esp01_inst_t *inst;
+    esp01_server_t *server = start(&inst);
+
+    for (int i = 0; i < 3; i++) {
+        mock_send(i * 1000, "2,CONNECT\r\n");
+        ipd(i * 1000 + 100, 2, "x\n");
+        mock_send(i * 1000 + 500, "2,CLOSED\r\n");
+    }
+    mock_send(3000, "2,CONNECT\r\n");
+    esp01_server_poll(server, 50);
+
+    MOCK_CHECK(server->stats.missed == 2 && server->stats.dropped_bytes == 4);
+    MOCK_CHECK(server->stats.accepted == 2 && server->stats.closed == 1);
+    MOCK_CHECK(server->conns[2].active);
+    MOCK_CHECK(strcmp(log_text, "connect2 data2:x close2 connect2 ") == 0);
+
+    esp01_server_deinit(server);
+    esp01_deinit(inst);
+}
+
+// Links outside of the pool are closed and their data dropped
+static void test_rejected(void) {
+    esp01_inst_t *inst;
+    esp01_server_t *server = start(&inst);
+
+    mock_link(4)->open = true;
+    mock_send(0, "4,CONNECT\r\n");
+    ipd(100, 4, "data\n");
+    esp01_server_poll(server, 50);
+
+    MOCK_CHECK(log_text[0] == '\0');
+    MOCK_CHECK(server->stats.rejected == 1 && server->stats.dropped_bytes == 5);
+    MOCK_CHECK(mock_command_count("AT+CIPCLOSE=4") == 1);
+
+    esp01_server_deinit(server);
+    esp01_deinit(inst);
+}
+
+// Events of the driver's own links
+static size_t client_received;
+static uint client_events;
+
+static void client_urc(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len, void *ctx) {
+    if (link_id == 4 && urc == ESP01_URC_DATA) {
+        client_received += len;
+    } else if (link_id == 4) {
+        client_events++;
+    }
+}
+
+// The links opened by esp01_ip_connect aren't server clients, their events go to the previous handler
+static void test_client_link(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_set_urc_handler(inst, client_urc, NULL);
+    esp01_server_t *server = esp01_server_init(inst, 80, 3, 10);
+    MOCK_CHECK(server != NULL);
+    esp01_server_set_handlers(server, on_connect, on_data, on_close, NULL);
+    log_text[0] = '\0';
+    client_received = 0;
+    client_events = 0;
+
+    MOCK_CHECK(esp01_ip_connect(inst, 4, ESP01_IP_TCP, "192.168.4.2", 5000));
+    ipd(100, 4, "reply\n");
+    esp01_server_poll(server, 50);
+
+    MOCK_CHECK(log_text[0] == '\0' && client_events == 1 && client_received == 6);
+    MOCK_CHECK(server->stats.rejected == 0 && server->stats.dropped_bytes == 0);
+    MOCK_CHECK(mock_command_count("AT+CIPCLOSE=4") == 0);
+
+    // Once closed, the link may be used by a server client again
+    MOCK_CHECK(esp01_ip_close(inst, 4));
+    MOCK_CHECK(client_events == 2);
+    mock_send(0, "4,CONNECT\r\n");
+    esp01_server_poll(server, 50);
+    MOCK_CHECK(server->stats.rejected == 1);
+
+    esp01_server_deinit(server);
+    MOCK_CHECK(inst->urc_handler == client_urc);
+    esp01_deinit(inst);
+}
+
+static bool ap_handler(const char *cmd, void *ctx) {
+    if (strcmp(cmd, "AT+CWSAP?") == 0) {
+        mock_reply(mock_default_config().cmd_latency_us, "+CWSAP:\"ap\",\"password\",1,3,8,0\r\n\r\nOK\r\n");
+        return true;
+    }
+    if (strncmp(cmd, "AT+CWSAP=", 9) == 0) {
+        mock_reply(mock_default_config().cmd_latency_us, "\r\nOK\r\n");
+        return true;
+    }
+    return false;
+}
+
+// The SoftAP station limit isn't the server pool size, hiding the SSID keeps the configured limit
+static void test_ap_config(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(ap_handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    esp01_ap_properties_t properties = ESP01_DEFAULT_AP_PROPERTIES;
+    strcpy(properties.ssid, "ap");
+    strcpy(properties.password, "password");
+    MOCK_CHECK(esp01_set_ap_config(inst, properties));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CWSAP=\"ap\",\"password\",1,3") == 0);
+
+    properties.ssid_hidden = 1;
+    MOCK_CHECK(esp01_set_ap_config(inst, properties));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CWSAP=\"ap\",\"password\",1,3,8,1") == 0);
+
+    properties.max_connections = 2;
+    MOCK_CHECK(esp01_set_ap_config(inst, properties));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CWSAP=\"ap\",\"password\",1,3,2,1") == 0);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_short_connection();
+    test_link_reuse();
+    test_event_queue_full();
+    test_rejected();
+    test_client_link();
+    test_ap_config();
+    printf("test_server: ok\n");
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <cstdint>
+#include <string>
+
+#include "esp01.hpp"
+#include "esp01_mock.h"
+
+// Events that didn't belong to a socket
+static std::string other_events;
+
+static void other_urc(esp01_inst_t *inst, esp01_urc_t urc, int link_id, const char *data, size_t len, void *ctx) {
+    if (urc == ESP01_URC_DATA) {
+        other_events += std::to_string(link_id) + ":" + std::string(data, len) + ";";
+    }
+}
+
+static std::string receive_all(esp01::Socket &socket, uint timeout_ms) {
+    std::string received;
+    socket.receive([&received](std::string_view chunk) { received += chunk; }, timeout_ms);
+    return received;
+}
+
+// String literals are sent without their terminator, other arrays whole
+static void test_send(void) {
+    mock_reset(NULL);
+    esp01::Esp01 esp(uart0, 115200, 0, 1);
+    esp01::Socket socket = esp.connect(0, ESP01_IP_TCP, "192.168.4.2", 5000);
+    MOCK_CHECK(socket);
+
+    MOCK_CHECK(socket.send("hello"));
+    MOCK_CHECK(mock_link(0)->tx_bytes == 5);
+
+    const char *str = "world";
+    MOCK_CHECK(socket.send(str));
+    MOCK_CHECK(mock_link(0)->tx_bytes == 10);
+
+    const uint8_t bytes[] = {0, 1, 2, 3};
+    MOCK_CHECK(socket.send(bytes));
+    MOCK_CHECK(mock_link(0)->tx_bytes == 14);
+}
+
+// Data received while another command runs is kept until the socket reads it, other links go to the user handler
+static void test_buffered_receive(void) {
+    mock_reset(NULL);
+    other_events.clear();
+    esp01::Esp01 esp(uart0, 115200, 0, 1);
+    MOCK_CHECK(esp.set_urc_handler(other_urc, nullptr));
+    esp01::Socket socket = esp.connect(0, ESP01_IP_TCP, "192.168.4.2", 5000);
+    MOCK_CHECK(socket);
+
+    mock_ipd_at(mock_now_us() + 100, 0, "ab\0\r\ncd", 7);
+    mock_ipd_at(mock_now_us() + 200, 1, "xy", 2);
+    MOCK_CHECK(esp.at(esp01::command<AT_QUERY>(AT_RAM)));
+    MOCK_CHECK(other_events == "1:xy;");
+
+    MOCK_CHECK(receive_all(socket, 0) == std::string("ab\0\r\ncd", 7));
+    MOCK_CHECK(receive_all(socket, 0).empty());
+
+    // Data polled by receive
+    mock_ipd_at(mock_now_us() + 1000, 0, "ef", 2);
+    MOCK_CHECK(receive_all(socket, 10) == "ef");
+    MOCK_CHECK(socket.dropped() == 0);
+}
+
+// A connection closed by the peer isn't closed again
+static void test_peer_close(void) {
+    mock_reset(NULL);
+    esp01::Esp01 esp(uart0, 115200, 0, 1);
+    esp01::Socket socket = esp.connect(0, ESP01_IP_TCP, "192.168.4.2", 5000);
+    MOCK_CHECK(socket);
+
+    mock_ipd_at(mock_now_us() + 100, 0, "bye", 3);
+    mock_send(200, "0,CLOSED\r\n");
+    mock_link(0)->open = false;
+    MOCK_CHECK(receive_all(socket, 10) == "bye");
+    MOCK_CHECK(socket.peer_closed());
+
+    MOCK_CHECK(socket.close());
+    MOCK_CHECK(mock_command_count("AT+CIPCLOSE") == 0);
+
+    // The link can be opened again
+    socket = esp.connect(0, ESP01_IP_TCP, "192.168.4.2", 5000);
+    MOCK_CHECK(socket && !socket.peer_closed());
+    MOCK_CHECK(socket.close());
+    MOCK_CHECK(mock_command_count("AT+CIPCLOSE") == 1);
+}
+
+int main(void) {
+    test_send();
+    test_buffered_receive();
+    test_peer_close();
+    printf("test_socket_cpp: ok\n");
+    return 0;
+}
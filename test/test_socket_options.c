@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Only the options set are sent, without trailing empty fields
+static void test_set(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    MOCK_CHECK(esp01_ip_connect(inst, 2, ESP01_IP_TCP, "192.168.4.2", 80));
+
+    esp01_socket_options_t options = ESP01_DEFAULT_SOCKET_OPTIONS;
+    MOCK_CHECK(esp01_set_socket_options(inst, 2, options));
+    MOCK_CHECK(mock_command_count("AT+CIPTCPOPT") == 0);
+
+    options.tcp_nodelay = 1;
+    options.set = ESP01_SOCKET_NODELAY;
+    MOCK_CHECK(esp01_set_socket_options(inst, 2, options));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CIPTCPOPT=2,,1") == 0);
+    MOCK_CHECK(mock_link(2)->tcp_nodelay == 1 && mock_link(2)->so_linger == -1);
+
+    // -1 is a valid linger value (disabled)
+    mock_link(2)->so_linger = 5;
+    options.so_linger = -1;
+    options.set = ESP01_SOCKET_LINGER;
+    MOCK_CHECK(esp01_set_socket_options(inst, 2, options));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CIPTCPOPT=2,-1") == 0);
+    MOCK_CHECK(mock_link(2)->so_linger == -1);
+
+    options.keep_alive = 30;
+    options.set = ESP01_SOCKET_KEEPALIVE;
+    MOCK_CHECK(esp01_set_socket_options(inst, 2, options));
+    MOCK_CHECK(strcmp(mock_last_command(), "AT+CIPTCPOPT=2,,,,30") == 0);
+
+    esp01_deinit(inst);
+}
+
+// The query always starts with the link ID
+static void test_get(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    MOCK_CHECK(esp01_ip_connect(inst, 0, ESP01_IP_TCP, "192.168.4.2", 80));
+    MOCK_CHECK(esp01_ip_connect(inst, 3, ESP01_IP_TCP, "192.168.4.3", 80));
+    mock_link(3)->tcp_nodelay = 1;
+    mock_link(3)->so_sndtimeo = 2500;
+
+    esp01_socket_options_t options = ESP01_DEFAULT_SOCKET_OPTIONS;
+    MOCK_CHECK(esp01_get_socket_options(inst, 3, &options));
+    MOCK_CHECK(options.so_linger == -1 && options.tcp_nodelay == 1 && options.so_sndtimeo == 2500);
+    MOCK_CHECK(options.keep_alive == 0 && options.set == ESP01_SOCKET_ALL);
+
+    // Single connection mode
+    mock_reset(NULL);
+    mock_set_multiple(false);
+    MOCK_CHECK(esp01_ip_connect(inst, ESP01_UNDEFINED, ESP01_IP_TCP, "192.168.4.2", 80));
+    mock_link(0)->tcp_nodelay = 1;
+
+    options = (esp01_socket_options_t) ESP01_DEFAULT_SOCKET_OPTIONS;
+    MOCK_CHECK(esp01_get_socket_options(inst, ESP01_UNDEFINED, &options));
+    MOCK_CHECK(options.so_linger == -1 && options.tcp_nodelay == 1 && options.so_sndtimeo == 0);
+
+    esp01_deinit(inst);
+}
+
+// The default options are applied at connect time
+static void test_default(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    esp01_socket_options_t options = {-1, 1, 0, 0, ESP01_SOCKET_NODELAY};
+    esp01_set_default_socket_options(inst, options);
+    MOCK_CHECK(esp01_ip_connect(inst, 1, ESP01_IP_TCP, "192.168.4.2", 80));
+    MOCK_CHECK(mock_link(1)->tcp_nodelay == 1);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_set();
+    test_get();
+    test_default();
+    printf("test_socket_options: ok\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+#define SAMPLE_LENGTH 16
+#define SAMPLES_PER_DATAGRAM (ESP01_TELEMETRY_MTU / SAMPLE_LENGTH)
+
+// Datagrams received by the peer
+static size_t datagram_lengths[8];
+static uint datagram_count;
+
+static bool peer(int link_id, const char *data, size_t len, uint64_t at_us, void *ctx) {
+    MOCK_CHECK(datagram_count < sizeof(datagram_lengths) / sizeof(datagram_lengths[0]));
+    datagram_lengths[datagram_count++] = len;
+    return true;
+}
+
+static esp01_telemetry_t *start(esp01_inst_t **inst) {
+    mock_reset(NULL);
+    mock_set_peer_handler(peer, NULL);
+    datagram_count = 0;
+    *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_telemetry_t *telemetry = esp01_telemetry_init(*inst, 0, "192.168.4.2", 5000,
+                                                        ESP01_TELEMETRY_DEFAULT_DEADLINE);
+    MOCK_CHECK(telemetry != NULL);
+    return telemetry;
+}
+
+static bool push(esp01_telemetry_t *telemetry, uint n) {
+    char sample[SAMPLE_LENGTH];
+    memset(sample, 's', sizeof(sample));
+    for (uint i = 0; i < n; i++) {
+        if (!esp01_telemetry_push(telemetry, sample, sizeof(sample))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Samples are packed in full datagrams, the buffers switch when the one being filled is full
+static void test_batching(void) {
+    esp01_inst_t *inst;
+    esp01_telemetry_t *telemetry = start(&inst);
+
+    MOCK_CHECK(push(telemetry, SAMPLES_PER_DATAGRAM));
+    MOCK_CHECK(!esp01_telemetry_poll(telemetry, false));
+    MOCK_CHECK(datagram_count == 0);
+
+    // The next sample goes to the other buffer, the full one is sent on the next poll
+    MOCK_CHECK(push(telemetry, 1));
+    MOCK_CHECK(esp01_telemetry_poll(telemetry, false));
+    MOCK_CHECK(datagram_count == 1 && datagram_lengths[0] == SAMPLES_PER_DATAGRAM * SAMPLE_LENGTH);
+
+    esp01_telemetry_stats_t stats = esp01_telemetry_get_stats(telemetry);
+    MOCK_CHECK(stats.datagrams == 1 && stats.samples == SAMPLES_PER_DATAGRAM);
+    MOCK_CHECK(stats.min_batch == SAMPLES_PER_DATAGRAM && stats.max_batch == SAMPLES_PER_DATAGRAM);
+    MOCK_CHECK(stats.dropped == 0 && stats.send_failures == 0);
+
+    // The pending sample is sent when the channel is closed
+    esp01_telemetry_deinit(telemetry);
+    MOCK_CHECK(datagram_count == 2 && datagram_lengths[1] == SAMPLE_LENGTH);
+    esp01_deinit(inst);
+}
+
+// A datagram that isn't full is sent once its first sample waited for the deadline
+static void test_deadline(void) {
+    esp01_inst_t *inst;
+    esp01_telemetry_t *telemetry = start(&inst);
+
+    MOCK_CHECK(push(telemetry, 3));
+    sleep_ms(ESP01_TELEMETRY_DEFAULT_DEADLINE / 2);
+    MOCK_CHECK(push(telemetry, 2));
+    MOCK_CHECK(!esp01_telemetry_poll(telemetry, false));
+
+    sleep_ms(ESP01_TELEMETRY_DEFAULT_DEADLINE / 2);
+    MOCK_CHECK(esp01_telemetry_poll(telemetry, false));
+    MOCK_CHECK(datagram_count == 1 && datagram_lengths[0] == 5 * SAMPLE_LENGTH);
+
+    // Forced flush
+    MOCK_CHECK(push(telemetry, 1));
+    MOCK_CHECK(esp01_telemetry_poll(telemetry, true));
+    MOCK_CHECK(datagram_count == 2 && datagram_lengths[1] == SAMPLE_LENGTH);
+
+    esp01_telemetry_stats_t stats = esp01_telemetry_get_stats(telemetry);
+    MOCK_CHECK(stats.datagrams == 2 && stats.samples == 6 && stats.min_batch == 1 && stats.max_batch == 5);
+    MOCK_CHECK(stats.max_latency_us >= ESP01_TELEMETRY_DEFAULT_DEADLINE * 1000);
+    MOCK_CHECK(stats.total_latency_us > stats.max_latency_us);
+
+    esp01_telemetry_deinit(telemetry);
+    esp01_deinit(inst);
+}
+
+// Samples are dropped when both buffers are full, when they are too long or when their datagram can't be sent
+static void test_drops(void) {
+    esp01_inst_t *inst;
+    esp01_telemetry_t *telemetry = start(&inst);
+
+    MOCK_CHECK(push(telemetry, 2 * SAMPLES_PER_DATAGRAM));
+    MOCK_CHECK(!push(telemetry, 1));
+    char sample[ESP01_TELEMETRY_MTU + 1] = {0};
+    MOCK_CHECK(!esp01_telemetry_push(telemetry, sample, sizeof(sample)));
+    MOCK_CHECK(esp01_telemetry_get_stats(telemetry).dropped == 2);
+
+    // The link is gone, the full datagram is lost
+    mock_link(0)->open = false;
+    MOCK_CHECK(!esp01_telemetry_poll(telemetry, false));
+    esp01_telemetry_stats_t stats = esp01_telemetry_get_stats(telemetry);
+    MOCK_CHECK(stats.send_failures == 1 && stats.dropped == 2 + SAMPLES_PER_DATAGRAM);
+    MOCK_CHECK(stats.datagrams == 0 && datagram_count == 0);
+
+    // The released buffer takes samples again
+    MOCK_CHECK(push(telemetry, 1));
+
+    esp01_telemetry_deinit(telemetry);
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_batching();
+    test_deadline();
+    test_drops();
+    printf("test_telemetry: ok\n");
+    return 0;
+}
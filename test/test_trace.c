@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+static char long_line[301];
+
+static bool handler(const char *cmd, void *ctx) {
+    if (strcmp(cmd, "AT+GMR") == 0) {
+        char rsp[sizeof(long_line) + 16];
+        sprintf(rsp, "%s\r\n\r\nOK\r\n", long_line);
+        mock_reply(100, rsp);
+        return true;
+    }
+    if (strcmp(cmd, "AT+UART_CUR?") == 0) {
+        mock_reply(100, "+UART_CUR:115200,8,1,7,0\r\n\r\nOK\r\n");
+        return true;
+    }
+    return false;
+}
+
+// Get the received data of the trace and check for an event
+static size_t read_trace(esp01_inst_t *inst, char *rx, esp01_trace_event_t event, bool *found) {
+    uint8_t records[ESP01_TRACE_RING_LENGTH];
+    uint len = esp01_trace_read(inst, records, sizeof(records));
+    size_t rx_len = 0;
+    *found = false;
+
+    for (uint8_t *record = records; record < records + len; record += ESP01_TRACE_HEADER_LENGTH + record[5]) {
+        uint8_t *data = record + ESP01_TRACE_HEADER_LENGTH;
+        if (record[4] == ESP01_TRACE_RX) {
+            memcpy(rx + rx_len, data, record[5]);
+            rx_len += record[5];
+        } else if (record[4] == ESP01_TRACE_EVENT && data[0] == event) {
+            *found = true;
+        }
+    }
+    rx[rx_len] = '\0';
+    return rx_len;
+}
+
+// A received chunk longer than a record is split, nothing is lost
+static void test_long_line(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    memset(long_line, 'v', sizeof(long_line) - 1);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    char *rsp = esp01_at_cmd(inst, ESP01_DEFAULT_TIMEOUT, AT_EXECUTE, AT_VERSION, "\n");
+    MOCK_CHECK(esp01_rsp_ok_free(rsp));
+
+    char rx[ESP01_TRACE_RING_LENGTH + 1];
+    bool found;
+    read_trace(inst, rx, ESP01_TRACE_MALFORMED, &found);
+    MOCK_CHECK(strstr(rx, long_line) != NULL);
+
+    esp01_deinit(inst);
+}
+
+// An unknown parity is reported in the trace
+static void test_malformed(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    esp01_uart_settings_t settings;
+    MOCK_CHECK(!esp01_get_uart_settings(inst, &settings, true));
+
+    char rx[ESP01_TRACE_RING_LENGTH + 1];
+    bool found;
+    read_trace(inst, rx, ESP01_TRACE_MALFORMED, &found);
+    MOCK_CHECK(found);
+
+    esp01_deinit(inst);
+}
+
+// The ring isn't read while another task owns the instance
+static void test_locked(void) {
+    mock_reset(NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+    esp01_set_sched_timeout(inst, 10);
+    MOCK_CHECK(esp01_test(inst));
+
+    mock_set_owner(1);
+    MOCK_CHECK(esp01_lock(inst, ESP01_PRIORITY_HIGH, 0));
+    mock_set_owner(0);
+    uint8_t records[ESP01_TRACE_RING_LENGTH];
+    MOCK_CHECK(esp01_trace_read(inst, records, sizeof(records)) == 0);
+
+    mock_set_owner(1);
+    esp01_unlock(inst);
+    mock_set_owner(0);
+    MOCK_CHECK(esp01_trace_read(inst, records, sizeof(records)) > 0);
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_long_line();
+    test_malformed();
+    test_locked();
+    printf("test_trace: ok\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "esp01.h"
+#include "esp01_mock.h"
+
+// Passive mode data of link 0, with the bytes a text response can't hold
+static const char recv_data[] = {'a', '\0', 'b', '\r', '\n', 'O', 'K', '\r', '\n', 'c'};
+
+static bool handler(const char *cmd, void *ctx) {
+    if (strcmp(cmd, "AT+CIPRECVDATA=0,10") != 0) {
+        return false;
+    }
+
+    char rsp[64];
+    size_t len = sprintf(rsp, "+CIPRECVDATA,%u:", (uint) sizeof(recv_data));
+    memcpy(rsp + len, recv_data, sizeof(recv_data));
+    len += sizeof(recv_data);
+    len += sprintf(rsp + len, "\r\n\r\nOK\r\n");
+    mock_send_at(mock_now_us() + mock_default_config().cmd_latency_us, rsp, len);
+    return true;
+}
+
+struct collect {
+    char data[128];
+    size_t len;
+} typedef collect_t;
+
+static bool collect_sink(const char *chunk, size_t len, void *ctx) {
+    collect_t *collect = ctx;
+    if (chunk == NULL) {
+        collect->len = 0;
+        return true;
+    }
+    MOCK_CHECK(collect->len + len <= sizeof(collect->data));
+    memcpy(collect->data + collect->len, chunk, len);
+    collect->len += len;
+    return true;
+}
+
+// The data of AT+CIPRECVDATA is read by its length, not by lines
+static void test_recv_data(void) {
+    mock_reset(NULL);
+    mock_set_cmd_handler(handler, NULL);
+    esp01_inst_t *inst = esp01_init(uart0, 115200, 0, 1);
+
+    collect_t collect = {{0}, 0};
+    MOCK_CHECK(esp01_at_cmd_stream(inst, ESP01_DEFAULT_TIMEOUT, collect_sink, &collect, AT_SET, AT_IP_SOCKET_DATA,
+                                   "0,10\n") == ESP01_RSP_OK);
+
+    const char header[] = "+CIPRECVDATA,10:";
+    MOCK_CHECK(collect.len == strlen(header) + sizeof(recv_data) + 2);
+    MOCK_CHECK(memcmp(collect.data, header, strlen(header)) == 0);
+    MOCK_CHECK(memcmp(collect.data + strlen(header), recv_data, sizeof(recv_data)) == 0);
+    MOCK_CHECK(memcmp(collect.data + collect.len - 2, "\n\n", 2) == 0);
+
+    // The exchange ended on the real termination word
+    MOCK_CHECK(esp01_test(inst));
+
+    esp01_deinit(inst);
+}
+
+int main(void) {
+    test_recv_data();
+    printf("test_transfer: ok\n");
+    return 0;
+}